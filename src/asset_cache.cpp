@@ -0,0 +1,143 @@
+﻿#include "asset_cache.h"
+
+#include <filesystem>
+#include <system_error>
+
+#include "util.h"
+
+static bool GetModifiedTime(const std::string& path, int64_t& mtime)
+{
+    std::error_code ec;
+    std::filesystem::file_time_type t = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    mtime = static_cast<int64_t>(t.time_since_epoch().count());
+    return true;
+}
+
+AssetCache::AssetCache(size_t budgetBytes)
+    : m_budget(budgetBytes)
+{}
+
+AssetCache::~AssetCache()
+{}
+
+std::shared_ptr<const Model> AssetCache::GetModel(const std::string& path)
+{
+    return Get<Model>(path, 'm');
+}
+
+std::shared_ptr<const TGAImage> AssetCache::GetTexture(const std::string& path)
+{
+    return Get<TGAImage>(path, 't');
+}
+
+AssetCache::Stats AssetCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+template<>
+std::shared_ptr<const Model> AssetCache::LoadAsset<Model>(const std::string& path, size_t& bytes)
+{
+    std::shared_ptr<Model> model = std::make_shared<Model>();
+    if (!model->Load(path.c_str())) {
+        return nullptr;
+    }
+    bytes = sizeof(Model) + model->GetMemoryUsage();
+    return model;
+}
+
+template<>
+std::shared_ptr<const TGAImage> AssetCache::LoadAsset<TGAImage>(const std::string& path, size_t& bytes)
+{
+    std::shared_ptr<TGAImage> image = std::make_shared<TGAImage>();
+    if (!image->Read(path.c_str())) {
+        return nullptr;
+    }
+    bytes = sizeof(TGAImage) + image->GetMemoryUsage();
+    return image;
+}
+
+template<typename T>
+std::shared_ptr<const T> AssetCache::Get(const std::string& path, char kind)
+{
+    int64_t mtime = 0;
+    if (!GetModifiedTime(path, mtime)) {
+        ERRORF("can't stat %s", path.c_str());
+        return nullptr;
+    }
+    // Models and textures share one budget, so the kind is part of the key.
+    std::string key = std::string(1, kind) + ':' + path;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        auto it = m_entries.find(key);
+        if (it == m_entries.end()) {
+            break;
+        }
+        std::shared_ptr<Entry> entry = it->second;
+        if (entry->loading) {
+            // Another thread is loading this path; wait for it rather than
+            // loading a second copy, then look the key up again.
+            m_loaded.wait(lock, [&entry] { return !entry->loading; });
+            continue;
+        }
+        if (entry->mtime != mtime) {
+            // The file changed on disk; drop the stale copy and reload.
+            Remove(entry.get());
+            break;
+        }
+        ++m_stats.hits;
+        m_lru.splice(m_lru.begin(), m_lru, entry->lru);
+        return std::static_pointer_cast<const T>(entry->asset);
+    }
+
+    ++m_stats.misses;
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->key = key;
+    entry->mtime = mtime;
+    entry->loading = true;
+    m_entries[key] = entry;
+    lock.unlock();
+
+    size_t bytes = 0;
+    std::shared_ptr<const T> asset = LoadAsset<T>(path, bytes);
+
+    lock.lock();
+    entry->loading = false;
+    if (!asset) {
+        m_entries.erase(key);
+    } else {
+        entry->asset = asset;
+        entry->bytes = bytes;
+        m_lru.push_front(entry.get());
+        entry->lru = m_lru.begin();
+        m_stats.bytes += bytes;
+        ++m_stats.entries;
+        Evict(entry.get());
+    }
+    m_loaded.notify_all();
+    return asset;
+}
+
+void AssetCache::Evict(Entry* keep)
+{
+    // The entry just loaded stays even when it alone exceeds the budget, so
+    // that the caller's next request for it is still a hit.
+    while (m_stats.bytes > m_budget && m_lru.back() != keep) {
+        Remove(m_lru.back());
+        ++m_stats.evictions;
+    }
+}
+
+void AssetCache::Remove(Entry* entry)
+{
+    m_lru.erase(entry->lru);
+    m_stats.bytes -= entry->bytes;
+    --m_stats.entries;
+    // Erasing may free entry, so the key must not be passed by reference.
+    m_entries.erase(m_entries.find(entry->key));
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+#include "model.h"
+#include "tga.h"
+
+// Loaded models and textures keyed by kind, path and modification time. Both
+// count against one budget, textures by their pixel bytes. Entries are
+// shared with readers, so evicting one only drops the cache's reference. Total
+// bytes are kept under a budget by evicting least recently used entries, and
+// concurrent requests for an asset that is still loading wait for that load.
+class AssetCache final
+{
+public:
+    struct Stats final
+    {
+        uint64_t hits{};
+        uint64_t misses{};
+        uint64_t evictions{};
+        size_t bytes{};
+        uint32_t entries{};
+    };
+
+    explicit AssetCache(size_t budgetBytes);
+    ~AssetCache();
+
+    std::shared_ptr<const Model> GetModel(const std::string& path);
+    std::shared_ptr<const TGAImage> GetTexture(const std::string& path);
+    Stats GetStats() const;
+
+private:
+    struct Entry final
+    {
+        std::string key{};
+        int64_t mtime{};
+        bool loading{};
+        std::shared_ptr<const void> asset{};
+        size_t bytes{};
+        std::list<Entry*>::iterator lru{};
+    };
+
+    template<typename T>
+    std::shared_ptr<const T> Get(const std::string& path, char kind);
+    template<typename T>
+    static std::shared_ptr<const T> LoadAsset(const std::string& path, size_t& bytes);
+    void Evict(Entry* keep);
+    void Remove(Entry* entry);
+
+private:
+    size_t m_budget{};
+    mutable std::mutex m_mutex{};
+    std::condition_variable m_loaded{};
+    std::map<std::string, std::shared_ptr<Entry>> m_entries{};
+    std::list<Entry*> m_lru{};
+    Stats m_stats{};
+};
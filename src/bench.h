@@ -0,0 +1,5 @@
+﻿#pragma once
+
+// Runs the benchmark suite called name ("all" runs every suite) and reports
+// timings through INFOF. Returns false for an unknown suite.
+bool RunBenchmark(const char* name);
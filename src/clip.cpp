@@ -0,0 +1,73 @@
+﻿#include "clip.h"
+
+static const uint32_t NUM_CLIP_PLANES = 7;
+
+// Plane i keeps points with dot(plane, (p, 1)) >= 0: w against CLIP_MIN_W
+// first, so later planes never see vertices behind the eye, then x, y against
+// the guard band and z against near/far.
+static const float CLIP_PLANES[NUM_CLIP_PLANES][5] = {
+    {0.f, 0.f, 0.f, 1.f, -CLIP_MIN_W},
+    {-1.f, 0.f, 0.f, GUARD_BAND, 0.f},
+    {1.f, 0.f, 0.f, GUARD_BAND, 0.f},
+    {0.f, -1.f, 0.f, GUARD_BAND, 0.f},
+    {0.f, 1.f, 0.f, GUARD_BAND, 0.f},
+    {0.f, 0.f, -1.f, 1.f, 0.f},
+    {0.f, 0.f, 1.f, 1.f, 0.f},
+};
+
+static uint32_t ViewportOutcode(const Vec4f& p)
+{
+    return (p.x > p.w ? 1 : 0) | (p.x < -p.w ? 2 : 0) | (p.y > p.w ? 4 : 0) | (p.y < -p.w ? 8 : 0) | (p.z > p.w ? 16 : 0) | (p.z < -p.w ? 32 : 0) | (p.w < CLIP_MIN_W ? 64 : 0);
+}
+
+static float PlaneDistance(uint32_t plane, const Vec4f& p)
+{
+    const float* c = CLIP_PLANES[plane];
+    return c[0] * p.x + c[1] * p.y + c[2] * p.z + c[3] * p.w + c[4];
+}
+
+uint32_t ClipTriangle(const Vec4f in[3], Vec4f out[MAX_CLIP_VERTS])
+{
+    if ((ViewportOutcode(in[0]) & ViewportOutcode(in[1]) & ViewportOutcode(in[2])) != 0) {
+        return 0;
+    }
+    uint32_t crossing = 0;
+    for (uint32_t plane = 0; plane < NUM_CLIP_PLANES; ++plane) {
+        if (PlaneDistance(plane, in[0]) < 0.f || PlaneDistance(plane, in[1]) < 0.f || PlaneDistance(plane, in[2]) < 0.f) {
+            crossing |= 1 << plane;
+        }
+    }
+    out[0] = in[0];
+    out[1] = in[1];
+    out[2] = in[2];
+    uint32_t count = 3;
+    if (crossing == 0) {
+        return count;
+    }
+
+    // Sutherland-Hodgman against only the planes the triangle crosses.
+    Vec4f buffer[MAX_CLIP_VERTS];
+    for (uint32_t plane = 0; plane < NUM_CLIP_PLANES && count > 0; ++plane) {
+        if (!((crossing >> plane) & 1)) {
+            continue;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            buffer[i] = out[i];
+        }
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            const Vec4f& a = buffer[i];
+            const Vec4f& b = buffer[(i + 1) % count];
+            float da = PlaneDistance(plane, a);
+            float db = PlaneDistance(plane, b);
+            if (da >= 0.f) {
+                out[n++] = a;
+            }
+            if ((da >= 0.f) != (db >= 0.f)) {
+                out[n++] = a + (b - a) * (da / (da - db));
+            }
+        }
+        count = n;
+    }
+    return count >= 3 ? count : 0;
+}
@@ -0,0 +1,23 @@
+﻿#pragma once
+
+#include <stdint.h>
+
+#include "vec4.h"
+
+// Each clip plane adds at most one vertex to the triangle.
+static const uint32_t MAX_CLIP_VERTS = 10;
+
+// Guard band half-extent in units of the viewport half-extent. Triangles that
+// stay inside it are rasterized unclipped and clamped to the viewport instead.
+static const float GUARD_BAND = 8.f;
+
+// Vertices closer to w = 0 than this are clipped away before the perspective
+// divide.
+static const float CLIP_MIN_W = 1e-5f;
+
+// Clips a clip-space triangle (-w <= x, y, z <= w is visible) and writes the
+// result as a convex polygon to out. Returns 0 when the triangle is entirely
+// outside one viewport plane, 3 with the input copied when it lies inside the
+// guard band and near/far planes, otherwise the number of clipped vertices.
+// Every vertex written has w >= CLIP_MIN_W, so PerspectiveDivide is safe.
+uint32_t ClipTriangle(const Vec4f in[3], Vec4f out[MAX_CLIP_VERTS]);
@@ -0,0 +1,104 @@
+﻿#include "depth_buffer.h"
+
+#include <algorithm>
+#include <string.h>
+
+static const DepthFormat DEPTH_FORMATS[] = {DepthFormat::D16, DepthFormat::D24, DepthFormat::D32F};
+
+DepthBuffer::DepthBuffer(int32_t width, int32_t height, DepthFormat format)
+{
+    Reset(width, height, format);
+}
+
+DepthBuffer::~DepthBuffer()
+{}
+
+void DepthBuffer::Reset(int32_t width, int32_t height, DepthFormat format)
+{
+    m_width = width;
+    m_height = height;
+    m_format = format;
+    m_tilesX = (width + DEPTH_TILE_SIZE - 1) / DEPTH_TILE_SIZE;
+    int32_t tilesY = (height + DEPTH_TILE_SIZE - 1) / DEPTH_TILE_SIZE;
+    // Stored as whole words so every format is suitably aligned.
+    size_t bytes = static_cast<size_t>(width) * height * GetBytesPerValue();
+    m_values.resize((bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    m_pendingTiles.resize(m_tilesX * tilesY);
+    Clear();
+}
+
+void DepthBuffer::Clear()
+{
+    std::fill(m_pendingTiles.begin(), m_pendingTiles.end(), 1);
+}
+
+void DepthBuffer::FlushClears()
+{
+    uint8_t* values = reinterpret_cast<uint8_t*>(m_values.data());
+    uint32_t bytesPerValue = GetBytesPerValue();
+    for (size_t i = 0; i < m_pendingTiles.size(); ++i) {
+        if (m_pendingTiles[i] == 0) {
+            continue;
+        }
+        int32_t x0 = static_cast<int32_t>(i % m_tilesX) * DEPTH_TILE_SIZE;
+        int32_t y0 = static_cast<int32_t>(i / m_tilesX) * DEPTH_TILE_SIZE;
+        int32_t x1 = std::min(m_width, x0 + DEPTH_TILE_SIZE);
+        int32_t y1 = std::min(m_height, y0 + DEPTH_TILE_SIZE);
+        for (int32_t y = y0; y < y1; ++y) {
+            memset(values + (static_cast<size_t>(y) * m_width + x0) * bytesPerValue, 0, (x1 - x0) * bytesPerValue);
+        }
+        m_pendingTiles[i] = 0;
+    }
+}
+
+int32_t DepthBuffer::GetRange() const
+{
+    switch (m_format) {
+    case DepthFormat::D16:
+        return DEPTH_RANGE_D16;
+    case DepthFormat::D24:
+        return DEPTH_RANGE_D24;
+    case DepthFormat::D32F:
+        return DEPTH_RANGE_D32F;
+    }
+    return 0;
+}
+
+uint32_t DepthBuffer::GetBytesPerValue() const
+{
+    return m_format == DepthFormat::D16 ? 2 : 4;
+}
+
+size_t DepthBuffer::GetMemoryUsage() const
+{
+    return m_values.capacity() * sizeof(uint32_t) + m_pendingTiles.capacity();
+}
+
+DepthTarget DepthBuffer::GetTarget()
+{
+    return DepthTarget{m_format, m_values.data(), m_pendingTiles.data()};
+}
+
+const char* GetDepthFormatName(DepthFormat format)
+{
+    switch (format) {
+    case DepthFormat::D16:
+        return "d16";
+    case DepthFormat::D24:
+        return "d24";
+    case DepthFormat::D32F:
+        return "d32f";
+    }
+    return "?";
+}
+
+bool ParseDepthFormat(const char* name, DepthFormat& format)
+{
+    for (DepthFormat f : DEPTH_FORMATS) {
+        if (strcmp(name, GetDepthFormatName(f)) == 0) {
+            format = f;
+            return true;
+        }
+    }
+    return false;
+}
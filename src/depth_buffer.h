@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "kernels.h"
+
+// Depth target in one of the DepthFormat layouts. Clear only flags every tile;
+// the rasterizer zeroes a tile the first time it touches it, so pixels no
+// triangle covers are never written at all.
+class DepthBuffer final
+{
+public:
+    DepthBuffer(int32_t width, int32_t height, DepthFormat format);
+    ~DepthBuffer();
+
+    // Reuses the allocation when the new size fits.
+    void Reset(int32_t width, int32_t height, DepthFormat format);
+    void Clear();
+    // Zeroes every tile still pending, for readers that bypass the flags.
+    void FlushClears();
+
+    DepthFormat GetFormat() const { return m_format; }
+    // Screen-space z must be mapped to [0, GetRange()].
+    int32_t GetRange() const;
+    uint32_t GetBytesPerValue() const;
+    size_t GetMemoryUsage() const;
+    DepthTarget GetTarget();
+
+private:
+    int32_t m_width{};
+    int32_t m_height{};
+    DepthFormat m_format{};
+    int32_t m_tilesX{};
+    std::vector<uint32_t> m_values{};
+    std::vector<uint8_t> m_pendingTiles{};
+};
+
+const char* GetDepthFormatName(DepthFormat format);
+// "d16", "d24" or "d32f"; false for anything else.
+bool ParseDepthFormat(const char* name, DepthFormat& format);
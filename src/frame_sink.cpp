@@ -0,0 +1,343 @@
+﻿#include "frame_sink.h"
+
+#include <errno.h>
+#include <new>
+#include <string.h>
+
+#include "util.h"
+
+#if !defined(OS_WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const size_t FRAME_SLOT_ALIGN = 64;
+
+static size_t FrameBytes(const TGAImage& image)
+{
+    return static_cast<size_t>(image.GetWidth()) * image.GetHeight() * image.GetBytesPP();
+}
+
+// Rows bottom to top, so the copy is also the vertical flip.
+static void CopyRowsFlipped(uint8_t* dst, const TGAImage& image)
+{
+    size_t rowBytes = static_cast<size_t>(image.GetWidth()) * image.GetBytesPP();
+    const uint8_t* src = image.GetData() + rowBytes * image.GetHeight();
+    for (uint32_t y = 0; y < image.GetHeight(); ++y) {
+        src -= rowBytes;
+        memcpy(dst + rowBytes * y, src, rowBytes);
+    }
+}
+
+bool WriteRawFrame(FILE* out, const TGAImage& image)
+{
+    size_t rowBytes = static_cast<size_t>(image.GetWidth()) * image.GetBytesPP();
+    for (uint32_t y = image.GetHeight(); y-- > 0;) {
+        if (fwrite(image.GetData() + rowBytes * y, 1, rowBytes, out) != rowBytes) {
+            ERRORF("can't write raw frame");
+            return false;
+        }
+    }
+    return fflush(out) == 0;
+}
+
+#if !defined(OS_WINDOWS)
+
+// Whether a slot header read under the seqlock describes a frame the ring can
+// hold: a TGA-sized image of a TGAFormat whose pixels are exactly size bytes.
+static bool IsValidFrame(const FrameView& frame, uint64_t maxFrameBytes)
+{
+    if (frame.width <= 0 || frame.width > UINT16_MAX || frame.height <= 0 || frame.height > UINT16_MAX) {
+        return false;
+    }
+    if (frame.format != 1 && frame.format != 3 && frame.format != 4) {
+        return false;
+    }
+    return frame.size <= maxFrameBytes && frame.size == static_cast<uint64_t>(frame.width) * frame.height * frame.format;
+}
+
+// Byte offset of the slot holding frameIndex.
+static size_t GetSlotOffset(const FrameRingHeader* header, uint64_t frameIndex)
+{
+    return sizeof(FrameRingHeader) + static_cast<size_t>(frameIndex % header->numSlots) * header->slotStride;
+}
+
+ShmFrameWriter::ShmFrameWriter()
+{}
+
+ShmFrameWriter::~ShmFrameWriter()
+{
+    Close();
+}
+
+bool ShmFrameWriter::Create(const char* name, uint32_t numSlots, size_t maxFrameBytes)
+{
+    Close();
+    if (numSlots < 2) {
+        ERRORF("a frame ring needs at least 2 slots");
+        return false;
+    }
+    size_t slotStride = (sizeof(FrameSlotHeader) + maxFrameBytes + FRAME_SLOT_ALIGN - 1) / FRAME_SLOT_ALIGN * FRAME_SLOT_ALIGN;
+    if (slotStride > UINT32_MAX) {
+        ERRORF("frames of %zu bytes are too large for a ring slot", maxFrameBytes);
+        return false;
+    }
+    size_t mapBytes = sizeof(FrameRingHeader) + slotStride * numSlots;
+
+    shm_unlink(name);
+    int32_t fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        ERRORF("can't create shared memory %s: %s", name, strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(mapBytes)) != 0) {
+        ERRORF("can't size shared memory %s to %zu bytes: %s", name, mapBytes, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    void* base = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        ERRORF("can't map shared memory %s: %s", name, strerror(errno));
+        shm_unlink(name);
+        return false;
+    }
+    m_name = name;
+    m_base = static_cast<uint8_t*>(base);
+    m_mapBytes = mapBytes;
+
+    // The object starts zeroed, which is also every slot's "never written"
+    // sequence. magic goes last so readers never see a half-made header.
+    FrameRingHeader* header = new (m_base) FrameRingHeader();
+    header->version = FRAME_RING_VERSION;
+    header->numSlots = numSlots;
+    header->slotStride = static_cast<uint32_t>(slotStride);
+    header->maxFrameBytes = maxFrameBytes;
+    for (uint32_t i = 0; i < numSlots; ++i) {
+        new (m_base + GetSlotOffset(header, i)) FrameSlotHeader();
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = FRAME_RING_MAGIC;
+    return true;
+}
+
+bool ShmFrameWriter::Publish(const TGAImage& image)
+{
+    if (m_base == nullptr) {
+        return false;
+    }
+    FrameRingHeader* header = reinterpret_cast<FrameRingHeader*>(m_base);
+    size_t size = FrameBytes(image);
+    if (size > header->maxFrameBytes) {
+        ERRORF("frame of %zu bytes exceeds the ring's %llu byte slots", size, static_cast<unsigned long long>(header->maxFrameBytes));
+        return false;
+    }
+    uint64_t index = header->published.load(std::memory_order_relaxed);
+    FrameSlotHeader* slot = reinterpret_cast<FrameSlotHeader*>(m_base + GetSlotOffset(header, index));
+    slot->sequence.store(index * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->frameIndex = index;
+    slot->width = static_cast<int32_t>(image.GetWidth());
+    slot->height = static_cast<int32_t>(image.GetHeight());
+    slot->format = image.GetBytesPP();
+    slot->size = size;
+    CopyRowsFlipped(reinterpret_cast<uint8_t*>(slot + 1), image);
+    slot->sequence.store(index * 2 + 2, std::memory_order_release);
+    header->published.store(index + 1, std::memory_order_release);
+    return true;
+}
+
+uint64_t ShmFrameWriter::GetNumPublished() const
+{
+    return m_base != nullptr ? reinterpret_cast<const FrameRingHeader*>(m_base)->published.load(std::memory_order_acquire) : 0;
+}
+
+void ShmFrameWriter::Close()
+{
+    if (m_base != nullptr) {
+        munmap(m_base, m_mapBytes);
+        shm_unlink(m_name.c_str());
+    }
+    m_name.clear();
+    m_base = nullptr;
+    m_mapBytes = 0;
+}
+
+ShmFrameReader::ShmFrameReader()
+{}
+
+ShmFrameReader::~ShmFrameReader()
+{
+    Close();
+}
+
+bool ShmFrameReader::Exists(const char* name)
+{
+    int32_t fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+bool ShmFrameReader::Open(const char* name)
+{
+    Close();
+    int32_t fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        ERRORF("can't open shared memory %s: %s", name, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(FrameRingHeader)) {
+        base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        ERRORF("can't map shared memory %s", name);
+        return false;
+    }
+    m_base = static_cast<const uint8_t*>(base);
+    m_mapBytes = st.st_size;
+
+    const FrameRingHeader* header = reinterpret_cast<const FrameRingHeader*>(m_base);
+    bool valid = header->magic == FRAME_RING_MAGIC && header->version == FRAME_RING_VERSION && header->numSlots >= 2;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!valid || sizeof(FrameRingHeader) + static_cast<size_t>(header->slotStride) * header->numSlots > m_mapBytes || header->slotStride < sizeof(FrameSlotHeader) + header->maxFrameBytes) {
+        ERRORF("%s is not a version %u frame ring", name, FRAME_RING_VERSION);
+        Close();
+        return false;
+    }
+    // Start with the oldest frame the ring still holds; the ones already gone
+    // count as dropped, so received + dropped adds up to frames published.
+    uint64_t published = GetNumPublished();
+    m_next = published >= header->numSlots ? published - (header->numSlots - 1) : 0;
+    m_dropped = m_next;
+    return true;
+}
+
+bool ShmFrameReader::Next(FrameView& frame)
+{
+    if (m_base == nullptr) {
+        return false;
+    }
+    const FrameRingHeader* header = reinterpret_cast<const FrameRingHeader*>(m_base);
+    for (;;) {
+        uint64_t published = GetNumPublished();
+        if (m_next >= published) {
+            return false;
+        }
+        // The slot after the newest frame may already be being rewritten.
+        if (published - m_next >= header->numSlots) {
+            m_dropped += published - (header->numSlots - 1) - m_next;
+            m_next = published - (header->numSlots - 1);
+        }
+        const FrameSlotHeader* slot = reinterpret_cast<const FrameSlotHeader*>(m_base + GetSlotOffset(header, m_next));
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        frame.frameIndex = slot->frameIndex;
+        frame.width = slot->width;
+        frame.height = slot->height;
+        frame.format = slot->format;
+        frame.size = slot->size;
+        frame.pixels = reinterpret_cast<const uint8_t*>(slot + 1);
+        frame.slot = slot;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence == m_next * 2 + 2 && slot->sequence.load(std::memory_order_relaxed) == sequence && IsValidFrame(frame, header->maxFrameBytes)) {
+            ++m_next;
+            return true;
+        }
+        // Overwritten between reading published and the slot, or not a frame
+        // this reader can use; look again.
+        ++m_dropped;
+        ++m_next;
+    }
+}
+
+bool ShmFrameReader::IsIntact(const FrameView& frame) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return frame.slot->sequence.load(std::memory_order_relaxed) == frame.frameIndex * 2 + 2;
+}
+
+uint64_t ShmFrameReader::GetNumPublished() const
+{
+    return m_base != nullptr ? reinterpret_cast<const FrameRingHeader*>(m_base)->published.load(std::memory_order_acquire) : 0;
+}
+
+void ShmFrameReader::Close()
+{
+    if (m_base != nullptr) {
+        munmap(const_cast<uint8_t*>(m_base), m_mapBytes);
+    }
+    m_base = nullptr;
+    m_mapBytes = 0;
+}
+
+#else
+
+ShmFrameWriter::ShmFrameWriter()
+{}
+
+ShmFrameWriter::~ShmFrameWriter()
+{}
+
+bool ShmFrameWriter::Create(const char* name, uint32_t numSlots, size_t maxFrameBytes)
+{
+    ERRORF("the frame ring needs POSIX shared memory");
+    return false;
+}
+
+bool ShmFrameWriter::Publish(const TGAImage& image)
+{
+    return false;
+}
+
+uint64_t ShmFrameWriter::GetNumPublished() const
+{
+    return 0;
+}
+
+void ShmFrameWriter::Close()
+{}
+
+ShmFrameReader::ShmFrameReader()
+{}
+
+ShmFrameReader::~ShmFrameReader()
+{}
+
+bool ShmFrameReader::Exists(const char* name)
+{
+    return false;
+}
+
+bool ShmFrameReader::Open(const char* name)
+{
+    ERRORF("the frame ring needs POSIX shared memory");
+    return false;
+}
+
+bool ShmFrameReader::Next(FrameView& frame)
+{
+    return false;
+}
+
+bool ShmFrameReader::IsIntact(const FrameView& frame) const
+{
+    return false;
+}
+
+uint64_t ShmFrameReader::GetNumPublished() const
+{
+    return 0;
+}
+
+void ShmFrameReader::Close()
+{}
+
+#endif
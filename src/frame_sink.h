@@ -0,0 +1,120 @@
+﻿#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#include "tga.h"
+
+// Finished frames leave the renderer uncompressed, top row first, with the
+// pixel layout of TGAImage (BGR, BGRA or gray). Images passed in are as
+// rendered, bottom row first, and are flipped while they are copied out.
+
+// Writes the frame's pixels and nothing else, e.g. for
+//   tinyrenderer --raw 120 | ffmpeg -f rawvideo -pixel_format bgr24 -video_size 800x500 -i - out.mp4
+bool WriteRawFrame(FILE* out, const TGAImage& image);
+
+// Shared-memory ring layout: a FrameRingHeader, then numSlots slots of
+// slotStride bytes, each a FrameSlotHeader followed by the pixels. Frame i goes
+// to slot i % numSlots; the producer never waits, so a consumer that falls more
+// than numSlots - 1 frames behind loses the oldest ones.
+static const uint32_t FRAME_RING_MAGIC = 0x52465254; // "TRFR"
+static const uint32_t FRAME_RING_VERSION = 1;
+
+struct alignas(64) FrameRingHeader final
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numSlots;
+    uint32_t slotStride;
+    // Largest frame a slot holds.
+    uint64_t maxFrameBytes;
+    // Frames published so far.
+    std::atomic<uint64_t> published;
+};
+
+// sequence is a seqlock: odd while the producer rewrites the slot, and
+// 2 * (frameIndex + 1) once frame frameIndex is complete. Readers check it
+// again after using the pixels to detect that the slot was reused meanwhile.
+struct alignas(64) FrameSlotHeader final
+{
+    std::atomic<uint64_t> sequence;
+    uint64_t frameIndex;
+    int32_t width;
+    int32_t height;
+    // TGAFormat: bytes per pixel.
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t size;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters must be address-free");
+
+// Single producer side of the ring.
+class ShmFrameWriter final
+{
+public:
+    ShmFrameWriter();
+    ~ShmFrameWriter();
+
+    // Creates the shared-memory object name (e.g. "/tinyrenderer"), replacing
+    // any earlier one, with numSlots slots of up to maxFrameBytes each. It is
+    // unlinked again when the writer is destroyed; mapped readers keep it.
+    bool Create(const char* name, uint32_t numSlots, size_t maxFrameBytes);
+    bool Publish(const TGAImage& image);
+    uint64_t GetNumPublished() const;
+
+private:
+    void Close();
+
+private:
+    std::string m_name{};
+    uint8_t* m_base{};
+    size_t m_mapBytes{};
+};
+
+// One frame as it sits in shared memory; no copy is made.
+struct FrameView final
+{
+    uint64_t frameIndex{};
+    int32_t width{};
+    int32_t height{};
+    uint32_t format{};
+    const uint8_t* pixels{};
+    size_t size{};
+    const FrameSlotHeader* slot{};
+};
+
+// Read-only consumer side; any number may attach to one writer.
+class ShmFrameReader final
+{
+public:
+    ShmFrameReader();
+    ~ShmFrameReader();
+
+    // Whether a writer has created name, without logging when it has not.
+    static bool Exists(const char* name);
+    bool Open(const char* name);
+    // The oldest frame not yet returned that is still in the ring; false when
+    // the reader has caught up with the writer. The header fields are copied
+    // into frame and checked, so size is width * height * format and within
+    // the slot. Frames skipped because they were overwritten, or were already
+    // gone when Open attached, are added to GetNumDropped.
+    bool Next(FrameView& frame);
+    // True if the producer has not started reusing frame's slot, i.e. what
+    // was read from frame.pixels so far is intact.
+    bool IsIntact(const FrameView& frame) const;
+    uint64_t GetNumPublished() const;
+    uint64_t GetNumDropped() const { return m_dropped; }
+
+private:
+    void Close();
+
+private:
+    const uint8_t* m_base{};
+    size_t m_mapBytes{};
+    uint64_t m_next{};
+    uint64_t m_dropped{};
+};
@@ -0,0 +1,136 @@
+﻿#include "kernels.h"
+
+#include <atomic>
+#include <string.h>
+
+#if defined(KERNELS_X86) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+extern const Kernels KERNELS_BASELINE;
+#if defined(KERNELS_X86)
+extern const Kernels KERNELS_SSE42;
+extern const Kernels KERNELS_AVX2;
+extern const Kernels KERNELS_AVX512;
+#endif
+
+static bool Always()
+{
+    return true;
+}
+
+#if defined(KERNELS_X86)
+#if defined(_MSC_VER)
+static bool HasCpuid7()
+{
+    int32_t regs[4];
+    __cpuid(regs, 0);
+    return regs[0] >= 7;
+}
+
+static bool HasSse42()
+{
+    int32_t regs[4];
+    __cpuid(regs, 1);
+    return (regs[2] >> 20) & 1;
+}
+
+// The CPU bits alone are not enough: the OS must also save the wider
+// registers (XCR0 bits 1-2 for AVX, 5-7 for AVX-512).
+static bool OsSaves(uint64_t xcr0Mask)
+{
+    int32_t regs[4];
+    __cpuid(regs, 1);
+    return ((regs[2] >> 27) & 1) && (_xgetbv(0) & xcr0Mask) == xcr0Mask;
+}
+
+static bool HasAvx2()
+{
+    int32_t regs[4];
+    __cpuid(regs, 1);
+    bool avx = (regs[2] >> 28) & 1;
+    if (!avx || !HasCpuid7() || !OsSaves(0x6)) {
+        return false;
+    }
+    __cpuidex(regs, 7, 0);
+    return (regs[1] >> 5) & 1;
+}
+
+static bool HasAvx512()
+{
+    if (!HasAvx2() || !OsSaves(0xe6)) {
+        return false;
+    }
+    int32_t regs[4];
+    __cpuidex(regs, 7, 0);
+    uint32_t ebx = static_cast<uint32_t>(regs[1]);
+    return ((ebx >> 16) & 1) && ((ebx >> 30) & 1) && ((ebx >> 31) & 1);
+}
+#else
+// libgcc's checks include the OS register-state test.
+static bool HasSse42()
+{
+    return __builtin_cpu_supports("sse4.2");
+}
+
+static bool HasAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+static bool HasAvx512()
+{
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl");
+}
+#endif
+#endif
+
+struct KernelVariant final
+{
+    const Kernels* kernels;
+    bool (*isSupported)();
+};
+
+static const KernelVariant KERNEL_VARIANTS[] = {
+    {&KERNELS_BASELINE, Always},
+#if defined(KERNELS_X86)
+    {&KERNELS_SSE42, HasSse42},
+    {&KERNELS_AVX2, HasAvx2},
+    {&KERNELS_AVX512, HasAvx512},
+#endif
+};
+
+static std::atomic<const Kernels*> s_forced{nullptr};
+
+const Kernels& GetKernels()
+{
+    const Kernels* forced = s_forced.load(std::memory_order_acquire);
+    if (forced != nullptr) {
+        return *forced;
+    }
+    static const Kernels* best = GetSupportedKernels().back();
+    return *best;
+}
+
+bool SelectKernels(const char* name)
+{
+    for (const Kernels* kernels : GetSupportedKernels()) {
+        if (strcmp(kernels->name, name) == 0) {
+            s_forced.store(kernels, std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<const Kernels*> GetSupportedKernels()
+{
+    std::vector<const Kernels*> supported;
+    for (const KernelVariant& variant : KERNEL_VARIANTS) {
+        if (variant.isSupported()) {
+            supported.push_back(variant.kernels);
+        }
+    }
+    return supported;
+}
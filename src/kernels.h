@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KERNELS_X86 1
+#endif
+
+// Depth layouts drawTriangle tests against (see DepthBuffer). Larger is
+// nearer and a cleared value of 0 is behind everything, so the test is always
+// "greater". The integer formats store screen-space z in
+// [0, DEPTH_RANGE_<format>] as z + 1.
+enum class DepthFormat : uint32_t
+{
+    D16,  // uint16_t unorm
+    D24,  // uint32_t, top 8 bits unused
+    D32F, // float reversed-Z: the unquantized depth, near 1 and far FLT_MIN
+};
+
+static const int32_t DEPTH_RANGE_D16 = 0xfffe;
+static const int32_t DEPTH_RANGE_D24 = 0xfffffe;
+// D32F ignores the integer z, so any range works; this one matches D24.
+static const int32_t DEPTH_RANGE_D32F = 0xfffffe;
+// Clears are deferred per square tile of this many pixels.
+static const int32_t DEPTH_TILE_SIZE = 64;
+
+struct DepthTarget final
+{
+    DepthFormat format;
+    // width x height values of format.
+    void* values;
+    // One flag per tile, row-major; nonzero means the tile still has to be
+    // cleared before its values are read.
+    uint8_t* pendingTiles;
+};
+
+// Hot loops compiled once per instruction set (kernels_<isa>.cpp, flags in
+// src/CMakeLists.txt). Every variant produces bit-identical results, so which
+// one runs only changes speed. Arguments are plain buffers so the variants
+// share no inline code with the rest of the program.
+struct Kernels final
+{
+    const char* name;
+    // tri holds three screen-space (x, y, z) points and z the same depths
+    // unquantized, in [0, 1] with near being 1; D32F stores the latter.
+    // Depth-tests against depth, clearing the tiles it touches first, and
+    // writes the low bytesPP bytes of color into pixels; both are
+    // width x height.
+    void (*drawTriangle)(const int32_t tri[9], const float z[3], const DepthTarget& depth, uint8_t* pixels, int32_t width, int32_t height, uint32_t bytesPP, uint32_t color);
+    // Row-major 4x4 matrix times (x, y, z, 1) with the perspective divide, for
+    // count packed xyz points.
+    void (*transformPoints)(const float m[16], const float* in, uint32_t count, float* out);
+    // TGA run-length packets; out needs numPixels * (bytesPP + 1) bytes.
+    size_t (*rleEncode)(const uint8_t* pixels, uint32_t numPixels, uint32_t bytesPP, uint8_t* out);
+    // False when the packets are truncated or overrun numPixels.
+    bool (*rleDecode)(const uint8_t* in, size_t size, uint8_t* pixels, uint32_t numPixels, uint32_t bytesPP);
+    void (*flipVertically)(uint8_t* pixels, uint32_t rowBytes, uint32_t height);
+    void (*flipHorizontally)(uint8_t* pixels, uint32_t width, uint32_t height, uint32_t bytesPP);
+};
+
+// The forced variant if any, otherwise the widest one this CPU supports.
+const Kernels& GetKernels();
+// Forces a variant by name for testing; false if unknown or unsupported here.
+bool SelectKernels(const char* name);
+// Variants this CPU can run, narrowest first.
+std::vector<const Kernels*> GetSupportedKernels();
@@ -0,0 +1,11 @@
+﻿// Built with AVX2 enabled (see src/CMakeLists.txt).
+#include "kernels.h"
+
+#if defined(KERNELS_X86)
+#if !defined(__AVX2__)
+#error kernels_avx2.cpp must be compiled with AVX2 enabled
+#endif
+#define KERNEL_NAME "avx2"
+#define KERNEL_TABLE KERNELS_AVX2
+#include "kernels_impl.h"
+#endif
@@ -0,0 +1,11 @@
+﻿// Built with AVX-512 F/BW/VL enabled (see src/CMakeLists.txt).
+#include "kernels.h"
+
+#if defined(KERNELS_X86)
+#if !defined(__AVX512BW__)
+#error kernels_avx512.cpp must be compiled with AVX-512 BW enabled
+#endif
+#define KERNEL_NAME "avx512"
+#define KERNEL_TABLE KERNELS_AVX512
+#include "kernels_impl.h"
+#endif
@@ -0,0 +1,4 @@
+﻿// Built with the project's default flags: SSE2 on x86-64, plain C++ elsewhere.
+#define KERNEL_NAME "baseline"
+#define KERNEL_TABLE KERNELS_BASELINE
+#include "kernels_impl.h"
@@ -0,0 +1,653 @@
+﻿// Included once by each kernels_<isa>.cpp after it defines KERNEL_NAME and
+// KERNEL_TABLE. Everything below is compiled for that file's instruction set,
+// so none of it may be shared with the rest of the program: it all lives in
+// an anonymous namespace, and it calls no inline function or template from a
+// shared header, std included. The linker keeps one copy of those for the
+// whole program, possibly this file's, so e.g. a std::max<int> instantiated
+// here could put AVX2 code under every caller. Hence the local Min/Max/Swap
+// and the private copy of RasterizeSpans. Only intrinsics, which are always
+// inlined, and memcpy/memset are used from outside.
+
+#include "kernels.h"
+
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(KERNELS_X86)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+template<typename T>
+T Min(T a, T b)
+{
+    return b < a ? b : a;
+}
+
+template<typename T>
+T Max(T a, T b)
+{
+    return a < b ? b : a;
+}
+
+template<typename T>
+void Swap(T& a, T& b)
+{
+    T tmp = a;
+    a = b;
+    b = tmp;
+}
+
+// Screen-space vertex; stands in for Vec3i.
+struct Point final
+{
+    int32_t x;
+    int32_t y;
+    int32_t z;
+};
+
+// from + (to - from) * t, truncated per component like Vec3i's operator*.
+Point Lerp(const Point& from, const Point& to, float t)
+{
+    return Point{from.x + static_cast<int32_t>((to.x - from.x) * t), from.y + static_cast<int32_t>((to.y - from.y) * t), from.z + static_cast<int32_t>((to.z - from.z) * t)};
+}
+
+// RasterizeSpans from raster.h with the clip rectangle fixed to the buffer;
+// the arithmetic must stay identical to it.
+template<typename F>
+void RasterizeSpans(Point t0, Point t1, Point t2, int32_t width, int32_t height, F span)
+{
+    if (t0.y == t1.y && t0.y == t2.y) {
+        return;
+    }
+    if (t0.y > t1.y) {
+        Swap(t0, t1);
+    }
+    if (t0.y > t2.y) {
+        Swap(t0, t2);
+    }
+    if (t1.y > t2.y) {
+        Swap(t1, t2);
+    }
+    int32_t total_height = t2.y - t0.y;
+    int32_t first = Max(0, -t0.y);
+    int32_t last = Min(total_height, height - t0.y);
+    for (int32_t i = first; i < last; ++i) {
+        float alpha = static_cast<float>(i) / total_height;
+        Point a = Lerp(t0, t2, alpha);
+        Point b;
+        bool second_half = (i > t1.y - t0.y) || (t1.y == t0.y);
+        if (second_half) {
+            int32_t segment_height = t2.y - t1.y;
+            float beta = static_cast<float>(i - (t1.y - t0.y)) / segment_height;
+            b = Lerp(t1, t2, beta);
+        } else {
+            int32_t segment_height = t1.y - t0.y;
+            float beta = static_cast<float>(i) / segment_height;
+            b = Lerp(t0, t1, beta);
+        }
+        if (a.x > b.x) {
+            Swap(a, b);
+        }
+        int32_t y = t0.y + i;
+        int32_t x0 = Max(a.x, 0);
+        int32_t x1 = Min(b.x, width);
+        if (x0 < x1) {
+            span(y, a, b, x0, x1);
+        }
+    }
+}
+
+#if defined(__AVX512BW__)
+#define KERNEL_VECTOR_BYTES 64
+typedef __m512i VectorBytes;
+
+inline VectorBytes LoadBytes(const uint8_t* p)
+{
+    return _mm512_loadu_si512(p);
+}
+
+inline void StoreBytes(uint8_t* p, VectorBytes v)
+{
+    _mm512_storeu_si512(p, v);
+}
+
+inline uint64_t EqualBytes(VectorBytes a, VectorBytes b)
+{
+    return _mm512_cmpeq_epi8_mask(a, b);
+}
+
+inline VectorBytes ReverseDwords(VectorBytes v)
+{
+    return _mm512_permutexvar_epi32(_mm512_set_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), v);
+}
+#elif defined(__AVX2__)
+#define KERNEL_VECTOR_BYTES 32
+typedef __m256i VectorBytes;
+
+inline VectorBytes LoadBytes(const uint8_t* p)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+inline void StoreBytes(uint8_t* p, VectorBytes v)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+inline uint64_t EqualBytes(VectorBytes a, VectorBytes b)
+{
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+}
+
+inline VectorBytes ReverseDwords(VectorBytes v)
+{
+    return _mm256_permutevar8x32_epi32(v, _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+#define KERNEL_VECTOR_BYTES 16
+typedef __m128i VectorBytes;
+
+inline VectorBytes LoadBytes(const uint8_t* p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+inline void StoreBytes(uint8_t* p, VectorBytes v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+inline uint64_t EqualBytes(VectorBytes a, VectorBytes b)
+{
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+}
+
+inline VectorBytes ReverseDwords(VectorBytes v)
+{
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+#endif
+
+inline uint32_t CountTrailingZeros(uint64_t v)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(v));
+#endif
+}
+
+// Value type of each DepthFormat and range of the integer ones; see kernels.h.
+template<DepthFormat FORMAT>
+struct DepthTraits;
+
+template<>
+struct DepthTraits<DepthFormat::D16> final
+{
+    typedef uint16_t Value;
+    static constexpr int32_t RANGE = DEPTH_RANGE_D16;
+};
+
+template<>
+struct DepthTraits<DepthFormat::D24> final
+{
+    typedef uint32_t Value;
+    static constexpr int32_t RANGE = DEPTH_RANGE_D24;
+};
+
+template<>
+struct DepthTraits<DepthFormat::D32F> final
+{
+    typedef float Value;
+};
+
+// A triangle's depth along each span, encoded for FORMAT. The integer formats
+// interpolate tri's z with the same arithmetic as SpanDepth in raster.h,
+// clamped to the format; branch-free so the compiler vectorizes it at this
+// file's width.
+template<DepthFormat FORMAT>
+class SpanDepth final
+{
+public:
+    typedef typename DepthTraits<FORMAT>::Value Value;
+
+    SpanDepth(const int32_t[9], const float[3])
+    {}
+
+    void SetSpan(int32_t, const Point& a, const Point& b)
+    {
+        m_a = a;
+        m_dx = static_cast<float>(b.x - a.x);
+        m_dz = static_cast<float>(b.z - a.z);
+    }
+
+    Value At(int32_t x) const
+    {
+        int32_t z = m_a.z + static_cast<int32_t>(m_dz * (static_cast<float>(x - m_a.x) / m_dx));
+        return static_cast<Value>(Min(Max(z, 0), DepthTraits<FORMAT>::RANGE) + 1);
+    }
+
+private:
+    Point m_a{};
+    float m_dx{};
+    float m_dz{};
+};
+
+// D32F evaluates the plane through the vertices' unquantized depths at each
+// pixel instead. Kept at FLT_MIN or above so the far plane still passes
+// against a cleared 0.
+template<>
+class SpanDepth<DepthFormat::D32F> final
+{
+public:
+    SpanDepth(const int32_t tri[9], const float z[3])
+        : m_x0(tri[0])
+        , m_y0(tri[1])
+        , m_z0(z[0])
+    {
+        double x1 = tri[3] - tri[0];
+        double y1 = tri[4] - tri[1];
+        double x2 = tri[6] - tri[0];
+        double y2 = tri[7] - tri[1];
+        double z1 = static_cast<double>(z[1]) - z[0];
+        double z2 = static_cast<double>(z[2]) - z[0];
+        double area = x1 * y2 - x2 * y1;
+        if (area != 0) {
+            m_dzdx = (z1 * y2 - z2 * y1) / area;
+            m_dzdy = (z2 * x1 - z1 * x2) / area;
+        } else {
+            // Edge-on: the spans are a line, drawn at its nearest depth.
+            m_z0 = Max(z[0], Max(z[1], z[2]));
+        }
+    }
+
+    // Measured from the span start so the float step stays small.
+    void SetSpan(int32_t y, const Point& a, const Point&)
+    {
+        m_ax = a.x;
+        m_start = static_cast<float>(m_z0 + m_dzdx * (a.x - m_x0) + m_dzdy * (y - m_y0));
+        m_step = static_cast<float>(m_dzdx);
+    }
+
+    float At(int32_t x) const
+    {
+        return Min(Max(m_start + m_step * static_cast<float>(x - m_ax), FLT_MIN), 1.f);
+    }
+
+private:
+    int32_t m_x0{};
+    int32_t m_y0{};
+    double m_z0{};
+    double m_dzdx{};
+    double m_dzdy{};
+    int32_t m_ax{};
+    float m_start{};
+    float m_step{};
+};
+
+// Zeroes one tile of values, clipped to the buffer.
+template<typename Value>
+void ClearDepthTile(Value* values, int32_t width, int32_t height, int32_t tileX, int32_t tileY)
+{
+    int32_t x0 = tileX * DEPTH_TILE_SIZE;
+    int32_t y0 = tileY * DEPTH_TILE_SIZE;
+    int32_t x1 = Min(width, x0 + DEPTH_TILE_SIZE);
+    int32_t y1 = Min(height, y0 + DEPTH_TILE_SIZE);
+    for (int32_t y = y0; y < y1; ++y) {
+        memset(values + static_cast<size_t>(y) * width + x0, 0, (x1 - x0) * sizeof(Value));
+    }
+}
+
+template<DepthFormat FORMAT, uint32_t BYTES_PP>
+void DrawTrianglePixels(const int32_t tri[9], const float z[3], const DepthTarget& depth, uint8_t* pixels, int32_t width, int32_t height, uint32_t color)
+{
+    typedef typename DepthTraits<FORMAT>::Value Value;
+    SpanDepth<FORMAT> spanDepth(tri, z);
+    const Point t0{tri[0], tri[1], tri[2]};
+    const Point t1{tri[3], tri[4], tri[5]};
+    const Point t2{tri[6], tri[7], tri[8]};
+    Value* values = static_cast<Value*>(depth.values);
+    const int32_t tilesX = (width + DEPTH_TILE_SIZE - 1) / DEPTH_TILE_SIZE;
+    uint8_t pattern[DEPTH_TILE_SIZE * BYTES_PP];
+    for (int32_t i = 0; i < DEPTH_TILE_SIZE; ++i) {
+        memcpy(pattern + i * BYTES_PP, &color, BYTES_PP);
+    }
+    RasterizeSpans(t0, t1, t2, width, height, [&](int32_t y, const Point& a, const Point& b, int32_t x0, int32_t x1) {
+        Value* zrow = values + static_cast<size_t>(y) * width;
+        uint8_t* prow = pixels + static_cast<size_t>(y) * width * BYTES_PP;
+        uint8_t* pendingRow = depth.pendingTiles + (y / DEPTH_TILE_SIZE) * tilesX;
+        spanDepth.SetSpan(y, a, b);
+        uint8_t passed[DEPTH_TILE_SIZE];
+        // One pass per tile the span crosses.
+        for (int32_t start = x0, end; start < x1; start = end) {
+            int32_t tileX = start / DEPTH_TILE_SIZE;
+            end = Min(x1, (tileX + 1) * DEPTH_TILE_SIZE);
+            if (pendingRow[tileX] != 0) {
+                ClearDepthTile(values, width, height, tileX, y / DEPTH_TILE_SIZE);
+                pendingRow[tileX] = 0;
+            }
+            for (int32_t x = start; x < end; ++x) {
+                Value value = spanDepth.At(x);
+                Value old = zrow[x];
+                zrow[x] = old < value ? value : old;
+                passed[x - start] = old < value;
+            }
+            // Color is written per run of passing pixels.
+            for (int32_t x = start; x < end;) {
+                if (!passed[x - start]) {
+                    ++x;
+                    continue;
+                }
+                int32_t run = x;
+                while (run < end && passed[run - start]) {
+                    ++run;
+                }
+                memcpy(prow + x * BYTES_PP, pattern, (run - x) * BYTES_PP);
+                x = run;
+            }
+        }
+    });
+}
+
+template<DepthFormat FORMAT>
+void DrawTriangleFormat(const int32_t tri[9], const float z[3], const DepthTarget& depth, uint8_t* pixels, int32_t width, int32_t height, uint32_t bytesPP, uint32_t color)
+{
+    switch (bytesPP) {
+    case 1:
+        DrawTrianglePixels<FORMAT, 1>(tri, z, depth, pixels, width, height, color);
+        break;
+    case 3:
+        DrawTrianglePixels<FORMAT, 3>(tri, z, depth, pixels, width, height, color);
+        break;
+    case 4:
+        DrawTrianglePixels<FORMAT, 4>(tri, z, depth, pixels, width, height, color);
+        break;
+    }
+}
+
+void DrawTriangle(const int32_t tri[9], const float z[3], const DepthTarget& depth, uint8_t* pixels, int32_t width, int32_t height, uint32_t bytesPP, uint32_t color)
+{
+    switch (depth.format) {
+    case DepthFormat::D16:
+        DrawTriangleFormat<DepthFormat::D16>(tri, z, depth, pixels, width, height, bytesPP, color);
+        break;
+    case DepthFormat::D24:
+        DrawTriangleFormat<DepthFormat::D24>(tri, z, depth, pixels, width, height, bytesPP, color);
+        break;
+    case DepthFormat::D32F:
+        DrawTriangleFormat<DepthFormat::D32F>(tri, z, depth, pixels, width, height, bytesPP, color);
+        break;
+    }
+}
+
+void TransformPoints(const float m[16], const float* in, uint32_t count, float* out)
+{
+    // One point per 128-bit lane: columns of m times broadcast x, y, z, then
+    // divided by the broadcast w. Each lane sums in Mat4::TransformPoint order
+    // and nothing is fused, so every variant matches the scalar result.
+    uint32_t i = 0;
+#if defined(__AVX512F__)
+    const __m512 c0 = _mm512_broadcast_f32x4(_mm_setr_ps(m[0], m[4], m[8], m[12]));
+    const __m512 c1 = _mm512_broadcast_f32x4(_mm_setr_ps(m[1], m[5], m[9], m[13]));
+    const __m512 c2 = _mm512_broadcast_f32x4(_mm_setr_ps(m[2], m[6], m[10], m[14]));
+    const __m512 c3 = _mm512_broadcast_f32x4(_mm_setr_ps(m[3], m[7], m[11], m[15]));
+    const __m512i xIndex = _mm512_setr_epi32(0, 0, 0, 0, 3, 3, 3, 3, 6, 6, 6, 6, 9, 9, 9, 9);
+    const __m512i one = _mm512_set1_epi32(1);
+    const __mmask16 packed = 0x0fff;
+    for (; i + 4 <= count; i += 4) {
+        __m512 p = _mm512_maskz_loadu_ps(packed, in + i * 3);
+        __m512 x = _mm512_permutexvar_ps(xIndex, p);
+        __m512 y = _mm512_permutexvar_ps(_mm512_add_epi32(xIndex, one), p);
+        __m512 z = _mm512_permutexvar_ps(_mm512_add_epi32(xIndex, _mm512_add_epi32(one, one)), p);
+        __m512 r = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(c0, x), _mm512_mul_ps(c1, y)), _mm512_mul_ps(c2, z)), c3);
+        __m512 q = _mm512_div_ps(r, _mm512_permute_ps(r, _MM_SHUFFLE(3, 3, 3, 3)));
+        _mm512_mask_storeu_ps(out + i * 3, packed, _mm512_maskz_compress_ps(0x7777, q));
+    }
+#elif defined(__AVX__)
+    __m256 c[4];
+    for (int32_t j = 0; j < 4; ++j) {
+        __m128 column = _mm_setr_ps(m[j], m[4 + j], m[8 + j], m[12 + j]);
+        c[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(column), column, 1);
+    }
+    // Two points per step; stores write a fourth float past each point, so the
+    // last point always goes through the scalar tail.
+    for (; i + 2 < count; i += 2) {
+        const float* p = in + i * 3;
+        __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(p[0])), _mm_set1_ps(p[3]), 1);
+        __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(p[1])), _mm_set1_ps(p[4]), 1);
+        __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(p[2])), _mm_set1_ps(p[5]), 1);
+        __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c[0], x), _mm256_mul_ps(c[1], y)), _mm256_mul_ps(c[2], z)), c[3]);
+        __m256 q = _mm256_div_ps(r, _mm256_permute_ps(r, _MM_SHUFFLE(3, 3, 3, 3)));
+        _mm_storeu_ps(out + i * 3, _mm256_castps256_ps128(q));
+        _mm_storeu_ps(out + i * 3 + 3, _mm256_extractf128_ps(q, 1));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128 c0 = _mm_setr_ps(m[0], m[4], m[8], m[12]);
+    const __m128 c1 = _mm_setr_ps(m[1], m[5], m[9], m[13]);
+    const __m128 c2 = _mm_setr_ps(m[2], m[6], m[10], m[14]);
+    const __m128 c3 = _mm_setr_ps(m[3], m[7], m[11], m[15]);
+    // The store writes a fourth float past the point, so the last point
+    // always goes through the scalar tail.
+    for (; i + 1 < count; ++i) {
+        const float* p = in + i * 3;
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])), _mm_mul_ps(c1, _mm_set1_ps(p[1]))), _mm_mul_ps(c2, _mm_set1_ps(p[2]))), c3);
+        _mm_storeu_ps(out + i * 3, _mm_div_ps(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3))));
+    }
+#endif
+    for (; i < count; ++i) {
+        float px = in[i * 3];
+        float py = in[i * 3 + 1];
+        float pz = in[i * 3 + 2];
+        float w = m[12] * px + m[13] * py + m[14] * pz + m[15];
+        out[i * 3] = (m[0] * px + m[1] * py + m[2] * pz + m[3]) / w;
+        out[i * 3 + 1] = (m[4] * px + m[5] * py + m[6] * pz + m[7]) / w;
+        out[i * 3 + 2] = (m[8] * px + m[9] * py + m[10] * pz + m[11]) / w;
+    }
+}
+
+template<uint32_t BYTES_PP>
+bool SamePixel(const uint8_t* a, const uint8_t* b)
+{
+    for (uint32_t k = 0; k < BYTES_PP; ++k) {
+        if (a[k] != b[k]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// First i in [from, limit) where whether pixel i equals pixel i + 1 differs
+// from equal, or limit. Compares a vector of bytes against the same bytes
+// shifted by one pixel and keeps the pairs whose bytes all matched.
+template<uint32_t BYTES_PP>
+uint32_t ScanPairs(const uint8_t* pixels, size_t numBytes, uint32_t from, uint32_t limit, bool equal)
+{
+    uint32_t i = from;
+#if defined(KERNEL_VECTOR_BYTES)
+    const uint32_t chunk = KERNEL_VECTOR_BYTES / BYTES_PP;
+    uint64_t pixelLanes = 0;
+    for (uint32_t k = 0; k < chunk; ++k) {
+        pixelLanes |= 1ull << (k * BYTES_PP);
+    }
+    while (i + chunk <= limit && (static_cast<size_t>(i) + 1) * BYTES_PP + KERNEL_VECTOR_BYTES <= numBytes) {
+        const uint8_t* p = pixels + static_cast<size_t>(i) * BYTES_PP;
+        uint64_t eq = EqualBytes(LoadBytes(p), LoadBytes(p + BYTES_PP));
+        uint64_t pairs = eq;
+        for (uint32_t k = 1; k < BYTES_PP; ++k) {
+            pairs &= eq >> k;
+        }
+        pairs &= pixelLanes;
+        uint64_t stop = equal ? ~pairs & pixelLanes : pairs;
+        if (stop != 0) {
+            return i + CountTrailingZeros(stop) / BYTES_PP;
+        }
+        i += chunk;
+    }
+#endif
+    for (; i < limit; ++i) {
+        const uint8_t* p = pixels + static_cast<size_t>(i) * BYTES_PP;
+        if (SamePixel<BYTES_PP>(p, p + BYTES_PP) != equal) {
+            return i;
+        }
+    }
+    return limit;
+}
+
+// Same packets as the original byte-at-a-time encoder: runs of equal pixels,
+// otherwise raw packets that stop right before the next run.
+template<uint32_t BYTES_PP>
+size_t RleEncodePixels(const uint8_t* pixels, uint32_t numPixels, uint8_t* out)
+{
+    const uint32_t maxChunkLength = 128;
+    const size_t numBytes = static_cast<size_t>(numPixels) * BYTES_PP;
+    uint8_t* o = out;
+    uint32_t cur = 0;
+    while (cur < numPixels) {
+        const uint8_t* p = pixels + static_cast<size_t>(cur) * BYTES_PP;
+        uint32_t maxLength = Min(maxChunkLength, numPixels - cur);
+        uint32_t length = 1;
+        bool raw = true;
+        if (maxLength > 1) {
+            raw = !SamePixel<BYTES_PP>(p, p + BYTES_PP);
+            uint32_t limit = cur + maxLength - 1;
+            if (raw) {
+                uint32_t stop = ScanPairs<BYTES_PP>(pixels, numBytes, cur + 1, limit, false);
+                length = stop == limit ? maxLength : stop - cur;
+            } else {
+                length = ScanPairs<BYTES_PP>(pixels, numBytes, cur, limit, true) - cur + 1;
+            }
+        }
+        *o++ = static_cast<uint8_t>(raw ? length - 1 : length + 127);
+        if (raw) {
+            memcpy(o, p, static_cast<size_t>(length) * BYTES_PP);
+            o += static_cast<size_t>(length) * BYTES_PP;
+        } else {
+            for (uint32_t k = 0; k < BYTES_PP; ++k) {
+                *o++ = p[k];
+            }
+        }
+        cur += length;
+    }
+    return o - out;
+}
+
+size_t RleEncode(const uint8_t* pixels, uint32_t numPixels, uint32_t bytesPP, uint8_t* out)
+{
+    switch (bytesPP) {
+    case 1:
+        return RleEncodePixels<1>(pixels, numPixels, out);
+    case 3:
+        return RleEncodePixels<3>(pixels, numPixels, out);
+    case 4:
+        return RleEncodePixels<4>(pixels, numPixels, out);
+    default:
+        return 0;
+    }
+}
+
+bool RleDecode(const uint8_t* in, size_t size, uint8_t* pixels, uint32_t numPixels, uint32_t bytesPP)
+{
+    size_t pos = 0;
+    uint32_t cur = 0;
+    while (cur < numPixels) {
+        if (pos >= size) {
+            return false;
+        }
+        uint8_t header = in[pos++];
+        uint32_t count = header < 128 ? header + 1u : header - 127u;
+        if (count > numPixels - cur) {
+            return false;
+        }
+        uint8_t* dst = pixels + static_cast<size_t>(cur) * bytesPP;
+        size_t n = static_cast<size_t>(count) * bytesPP;
+        if (header < 128) {
+            if (size - pos < n) {
+                return false;
+            }
+            memcpy(dst, in + pos, n);
+            pos += n;
+        } else {
+            if (size - pos < bytesPP) {
+                return false;
+            }
+            // Replicate the pixel by doubling the filled prefix.
+            memcpy(dst, in + pos, bytesPP);
+            for (size_t filled = bytesPP; filled < n; filled *= 2) {
+                memcpy(dst + filled, dst, Min(filled, n - filled));
+            }
+            pos += bytesPP;
+        }
+        cur += count;
+    }
+    return true;
+}
+
+void SwapBytes(uint8_t* a, uint8_t* b, size_t n)
+{
+    size_t i = 0;
+#if defined(KERNEL_VECTOR_BYTES)
+    for (; i + KERNEL_VECTOR_BYTES <= n; i += KERNEL_VECTOR_BYTES) {
+        VectorBytes va = LoadBytes(a + i);
+        VectorBytes vb = LoadBytes(b + i);
+        StoreBytes(a + i, vb);
+        StoreBytes(b + i, va);
+    }
+#endif
+    for (; i < n; ++i) {
+        Swap(a[i], b[i]);
+    }
+}
+
+void FlipVertically(uint8_t* pixels, uint32_t rowBytes, uint32_t height)
+{
+    for (uint32_t i = 0; i < height / 2; ++i) {
+        SwapBytes(pixels + static_cast<size_t>(i) * rowBytes, pixels + static_cast<size_t>(height - 1 - i) * rowBytes, rowBytes);
+    }
+}
+
+void FlipHorizontally(uint8_t* pixels, uint32_t width, uint32_t height, uint32_t bytesPP)
+{
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t* row = pixels + static_cast<size_t>(y) * width * bytesPP;
+        // Pixels [l, r) are still to be swapped.
+        uint32_t l = 0;
+        uint32_t r = width;
+#if defined(KERNEL_VECTOR_BYTES)
+        if (bytesPP == 4) {
+            const uint32_t n = KERNEL_VECTOR_BYTES / 4;
+            for (; r - l >= 2 * n; l += n, r -= n) {
+                VectorBytes left = LoadBytes(row + l * 4);
+                VectorBytes right = LoadBytes(row + (r - n) * 4);
+                StoreBytes(row + l * 4, ReverseDwords(right));
+                StoreBytes(row + (r - n) * 4, ReverseDwords(left));
+            }
+        }
+#endif
+        for (; l + 1 < r; ++l, --r) {
+            uint8_t tmp[4];
+            memcpy(tmp, row + l * bytesPP, bytesPP);
+            memcpy(row + l * bytesPP, row + (r - 1) * bytesPP, bytesPP);
+            memcpy(row + (r - 1) * bytesPP, tmp, bytesPP);
+        }
+    }
+}
+}  // namespace
+
+extern const Kernels KERNEL_TABLE;
+const Kernels KERNEL_TABLE = {
+    KERNEL_NAME,
+    DrawTriangle,
+    TransformPoints,
+    RleEncode,
+    RleDecode,
+    FlipVertically,
+    FlipHorizontally,
+};
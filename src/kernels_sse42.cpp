@@ -0,0 +1,8 @@
+﻿// Built with SSE4.2 enabled (see src/CMakeLists.txt).
+#include "kernels.h"
+
+#if defined(KERNELS_X86)
+#define KERNEL_NAME "sse4.2"
+#define KERNEL_TABLE KERNELS_SSE42
+#include "kernels_impl.h"
+#endif
@@ -1,15 +1,37 @@
-﻿#include <cmath>
+﻿#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <limits>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "bench.h"
+#include "clip.h"
+#include "depth_buffer.h"
+#include "frame_sink.h"
+#include "kernels.h"
 #include "model.h"
+#include "model_stream.h"
+#include "msaa.h"
+#include "raster.h"
+#include "renderer.h"
+#include "scene_renderer.h"
+#include "server.h"
 #include "tga.h"
 #include "util.h"
 #include "vec2.h"
 
 static const int32_t WIDTH = 800;
 static const int32_t HEIGHT = 500;
-static const int32_t DEPTH = 255;
+static const uint32_t STREAM_CHUNK_FACES = 64 * 1024;
+static const int32_t SERVER_MAX_WIDTH = 2048;
+static const int32_t SERVER_MAX_HEIGHT = 2048;
+static const size_t SERVER_CACHE_BUDGET = 256 * 1024 * 1024;
+static const uint32_t SHM_RING_SLOTS = 4;
 
 void DrawLine(const Vec2i& p0, const Vec2i& p1, TGAImage& image, const TGAColor& color)
 {
@@ -45,52 +67,6 @@ void DrawLine(const Vec2i& p0, const Vec2i& p1, TGAImage& image, const TGAColor&
         }
     }
 }
-void DrawTraiangle(Vec3i t0, Vec3i t1, Vec3i t2, int32_t* zbuffer, TGAImage& image, const TGAColor& color)
-{
-    if (t0.y == t1.y && t0.y == t2.y) {
-        return;
-    }
-    if (t0.y > t1.y) {
-        std::swap(t0, t1);
-    }
-    if (t0.y > t2.y) {
-        std::swap(t0, t2);
-    }
-    if (t1.y > t2.y) {
-        std::swap(t1, t2);
-    }
-    int32_t total_height = t2.y - t0.y;
-    for (int32_t i = 0; i < total_height; ++i) {
-        float alpha = static_cast<float>(i) / total_height;
-        Vec3i a = t0 + (t2 - t0) * alpha;
-        Vec3i b;
-        bool second_half = (i > t1.y - t0.y) || (t1.y == t0.y);
-        if (second_half) {
-            int32_t segment_height = t2.y - t1.y;
-            float beta = static_cast<float>(i - (t1.y - t0.y)) / segment_height;
-            b = t1 + (t2 - t1) * beta;
-        } else {
-            int32_t segment_height = t1.y - t0.y;
-            float beta = static_cast<float>(i) / segment_height;
-            b = t0 + (t1 - t0) * beta;
-        }
-        if (a.x > b.x) {
-            std::swap(a, b);
-        }
-        for (int32_t j = a.x; j < b.x; ++j) {
-            float phi = b.x == a.x ? 1.f : (float)(j - a.x) / (float)(b.x - a.x);
-            Vec3i p = a + (b - a) * phi;
-            p.x = j;
-            p.y = t0.y + i;  // a hack to fill holes (due to int cast precision problems)
-            int32_t idx = j + (t0.y + i) * WIDTH;
-            if (zbuffer[idx] < p.z) {
-                zbuffer[idx] = p.z;
-                image.SetColor(p.x, p.y, color);
-            }
-        }
-    }
-}
-
 void Rasterize(Vec2i p0, Vec2i p1, TGAImage& image, const TGAColor& color, int32_t ybuffer[])
 {
     if (p0.x > p1.x) {
@@ -111,35 +87,579 @@ Vec3f World2Screen(const Vec3f& v)
     return Vec3f((v.x + 1.f) * WIDTH / 2 + 0.5f, (v.y + 1.f) * HEIGHT / 2 + 0.5f, v.z);
 }
 
-int main(int argc, char** argv)
+bool DrawModel(const char* filename, FrameBuffer& fb, const Vec3f& light_dir)
+{
+    Model* model = new Model();
+    if (!model->Load(filename)) {
+        ERRORF("can't load %s", filename);
+        delete model;
+        return false;
+    }
+    RenderModel(*model, Mat4::Identity(), light_dir, fb);
+    delete model;
+    return true;
+}
+
+// Default render through a 4x MSAA target instead of the frame buffer.
+bool DrawModelMsaa(const char* filename, TGAImage& image, const Vec3f& light_dir)
+{
+    Model* model = new Model();
+    if (!model->Load(filename)) {
+        ERRORF("can't load %s", filename);
+        delete model;
+        return false;
+    }
+    MsaaTarget* msaa = new MsaaTarget(image.GetWidth(), image.GetHeight());
+    RenderModel(*model, Mat4::Identity(), light_dir, *msaa);
+    msaa->Resolve(image);
+    INFOF("%u edge pixels, %.2f MiB", msaa->GetNumEdgePixels(), msaa->GetMemoryUsage() / 1048576.0);
+    delete msaa;
+    delete model;
+    return true;
+}
+
+// Out-of-core path: faces are read and rasterized chunk by chunk, so only the
+// current chunk and the resident vertex pages are held in memory. Normals and
+// intensities are batched per chunk with the same kernels Model uses.
+bool DrawModelStreamed(const char* filename, size_t budgetBytes, FrameBuffer& fb, const Vec3f& light_dir)
+{
+    ModelStream* stream = new ModelStream();
+    if (!stream->Open(filename, budgetBytes)) {
+        ERRORF("can't load %s", filename);
+        delete stream;
+        return false;
+    }
+    std::vector<uint32_t> tris;
+    std::vector<Vec3f> corners;
+    Vec3SoA normals;
+    std::vector<float> intensities;
+    uint32_t numFaces = 0;
+    while (stream->ReadFaces(tris, STREAM_CHUNK_FACES)) {
+        corners.resize(tris.size());
+        for (size_t i = 0; i < tris.size(); ++i) {
+            corners[i] = stream->GetVert(tris[i]);
+        }
+        uint32_t chunkFaces = static_cast<uint32_t>(tris.size() / 3);
+        Model::ComputeFaceNormals(corners.data(), chunkFaces, normals);
+        Model::ComputeIntensities(normals, light_dir, intensities);
+        for (uint32_t i = 0; i < chunkFaces; ++i) {
+            DrawFace(&corners[i * 3], intensities[i], fb);
+        }
+        numFaces += chunkFaces;
+    }
+    INFOF("# f# %u page misses %llu", numFaces, static_cast<unsigned long long>(stream->GetCache().GetNumMisses()));
+    delete stream;
+    return true;
+}
+
+// Lookdev-style parameter sweep: one full frame, then light nudges and object
+// moves applied incrementally, checked against a full re-render at the end.
+bool RunSweep(const char* filename, uint32_t frames)
 {
     Model* model = new Model();
-    model->Load("african_head.obj");
-    int32_t* zbuffer = new int32_t[WIDTH * HEIGHT];
-    for (int32_t i = 0; i < WIDTH * HEIGHT; ++i) {
-        zbuffer[i] = std::numeric_limits<int32_t>::min();
+    if (!model->Load(filename)) {
+        ERRORF("can't load %s", filename);
+        delete model;
+        return false;
     }
+    const Vec3f offsets[] = {Vec3f(-0.5f, -0.5f, 0.f), Vec3f(0.5f, -0.5f, 0.f), Vec3f(-0.5f, 0.5f, 0.f), Vec3f(0.5f, 0.5f, 0.f)};
+    SceneRenderer* scene = new SceneRenderer(WIDTH, HEIGHT, DEPTH);
+    for (const Vec3f& offset : offsets) {
+        scene->AddObject(model, 0.5f, offset);
+    }
+
+    uint64_t start = GetTimeNs();
+    for (uint32_t i = 0; i < frames; ++i) {
+        scene->Render();
+    }
+    double fullMs = (GetTimeNs() - start) / 1e6 / frames;
+
+    Vec3f light_dir;
+    uint64_t shaded = 0;
+    start = GetTimeNs();
+    for (uint32_t i = 0; i < frames; ++i) {
+        float a = 0.02f * (i + 1);
+        light_dir = Vec3f(std::sin(a), 0.f, -std::cos(a));
+        scene->SetLight(light_dir);
+        scene->Update();
+        shaded += scene->GetNumShadedPixels();
+    }
+    double lightMs = (GetTimeNs() - start) / 1e6 / frames;
 
+    Vec3f offset = offsets[0];
+    uint64_t tiles = 0;
+    start = GetTimeNs();
+    for (uint32_t i = 0; i < frames; ++i) {
+        offset.x += 0.002f;
+        scene->MoveObject(0, offset);
+        tiles += scene->Update();
+    }
+    double moveMs = (GetTimeNs() - start) / 1e6 / frames;
+
+    INFOF("full frame %.3f ms", fullMs);
+    INFOF("light change %.3f ms (x%.1f), %llu pixels re-shaded per update", lightMs, fullMs / lightMs, static_cast<unsigned long long>(shaded / frames));
+    INFOF("object move %.3f ms (x%.1f), %llu tiles re-rasterized per update", moveMs, fullMs / moveMs, static_cast<unsigned long long>(tiles / frames));
+
+    SceneRenderer* reference = new SceneRenderer(WIDTH, HEIGHT, DEPTH);
+    for (const Vec3f& o : offsets) {
+        reference->AddObject(model, 0.5f, &o == &offsets[0] ? offset : o);
+    }
+    reference->SetLight(light_dir);
+    reference->Render();
+    uint32_t mismatches = 0;
+    for (int32_t y = 0; y < HEIGHT; ++y) {
+        for (int32_t x = 0; x < WIDTH; ++x) {
+            mismatches += scene->GetImage().GetColor(x, y).val != reference->GetImage().GetColor(x, y).val;
+        }
+    }
+    INFOF("%u pixels differ from a full re-render", mismatches);
+
+    TGAImage image(scene->GetImage());
+    image.FlipVertically();
+    image.Write("output.tga");
+    delete reference;
+    delete scene;
+    delete model;
+    return mismatches == 0;
+}
+
+// Renders the model with 4x MSAA and with the 4x supersample-and-downscale
+// approach it replaces, and reports memory and frame time of both.
+bool RunMsaaComparison(const char* filename, uint32_t frames)
+{
+    Model* model = new Model();
+    if (!model->Load(filename)) {
+        ERRORF("can't load %s", filename);
+        delete model;
+        return false;
+    }
+    std::vector<float> intensities;
+    model->ComputeIntensities(Vec3f(0, 0, -1.f), intensities);
+
+    MsaaTarget* msaa = new MsaaTarget(WIDTH, HEIGHT);
     TGAImage image(WIDTH, HEIGHT, TGAFormat::RGB);
-    Vec3f light_dir(0, 0, -1.f);
-    for (uint32_t i = 0; i < model->GetNumFaces(); ++i) {
-        const std::vector<uint32_t>& face = model->GetFace(i);
-        Vec3i screen_coords[3];
-        Vec3f world_coords[3];
-        for (int32_t i = 0; i < 3; ++i) {
-            const Vec3f& v = model->GetVert(face[i]);
-            screen_coords[i] = Vec3i(static_cast<int32_t>((v.x + 1.f) * WIDTH / 2), static_cast<int32_t>((v.y + 1.f) * HEIGHT / 2), static_cast<int32_t>((v.z + 1.f) * DEPTH / 2));
-            world_coords[i] = v;
-        }
-        Vec3f n = (world_coords[2] - world_coords[0]).Cross(world_coords[1] - world_coords[0]);
-        n.Normalize();
-        float intensity = n.Dot(light_dir);
-        if (intensity > 0) {
-            DrawTraiangle(screen_coords[0], screen_coords[1], screen_coords[2], zbuffer, image, TGAColor(static_cast<uint8_t>(intensity * 255), static_cast<uint8_t>(intensity * 255), static_cast<uint8_t>(intensity * 255), 255));
+    uint64_t start = GetTimeNs();
+    for (uint32_t f = 0; f < frames; ++f) {
+        msaa->Clear(0);
+        for (uint32_t i = 0; i < model->GetNumFaces(); ++i) {
+            if (intensities[i] <= 0) {
+                continue;
+            }
+            const std::vector<uint32_t>& face = model->GetFace(i);
+            const Vec3f world_coords[3] = {model->GetVert(face[0]), model->GetVert(face[1]), model->GetVert(face[2])};
+            DrawFace(world_coords, intensities[i], *msaa);
         }
+        msaa->Resolve(image);
     }
+    double msaaMs = (GetTimeNs() - start) / 1e6 / frames;
+    size_t msaaBytes = msaa->GetMemoryUsage();
+    uint32_t edgePixels = msaa->GetNumEdgePixels();
+
+    const int32_t ssWidth = WIDTH * 2;
+    const int32_t ssHeight = HEIGHT * 2;
+    std::vector<int32_t> zbuffer(ssWidth * ssHeight);
+    TGAImage big(ssWidth, ssHeight, TGAFormat::RGB);
+    TGAImage downscaled(WIDTH, HEIGHT, TGAFormat::RGB);
+    start = GetTimeNs();
+    for (uint32_t f = 0; f < frames; ++f) {
+        std::fill(zbuffer.begin(), zbuffer.end(), std::numeric_limits<int32_t>::min());
+        memset(big.GetData(), 0, ssWidth * ssHeight * 3);
+        for (uint32_t i = 0; i < model->GetNumFaces(); ++i) {
+            if (intensities[i] <= 0) {
+                continue;
+            }
+            const std::vector<uint32_t>& face = model->GetFace(i);
+            uint8_t c = static_cast<uint8_t>(intensities[i] * 255);
+            uint8_t* data = big.GetData();
+            RasterizeTriangle(NdcToScreen(model->GetVert(face[0]), ssWidth, ssHeight, DEPTH), NdcToScreen(model->GetVert(face[1]), ssWidth, ssHeight, DEPTH), NdcToScreen(model->GetVert(face[2]), ssWidth, ssHeight, DEPTH), Rect{0, 0, ssWidth, ssHeight}, [&](int32_t x, int32_t y, int32_t z) {
+                int32_t idx = x + y * ssWidth;
+                if (zbuffer[idx] < z) {
+                    zbuffer[idx] = z;
+                    memset(data + idx * 3, c, 3);
+                }
+            });
+        }
+        const uint8_t* src = big.GetData();
+        uint8_t* dst = downscaled.GetData();
+        for (int32_t y = 0; y < HEIGHT; ++y) {
+            for (int32_t x = 0; x < WIDTH; ++x) {
+                for (int32_t byte = 0; byte < 3; ++byte) {
+                    const uint8_t* p = src + ((x * 2) + (y * 2) * ssWidth) * 3 + byte;
+                    dst[(x + y * WIDTH) * 3 + byte] = static_cast<uint8_t>((p[0] + p[3] + p[ssWidth * 3] + p[ssWidth * 3 + 3] + 2) / 4);
+                }
+            }
+        }
+    }
+    double ssaaMs = (GetTimeNs() - start) / 1e6 / frames;
+    size_t ssaaBytes = zbuffer.size() * sizeof(int32_t) + ssWidth * ssHeight * 3;
+
+    INFOF("4x MSAA  %.3f ms/frame, %.2f MiB (%u edge pixels)", msaaMs, msaaBytes / 1048576.0, edgePixels);
+    INFOF("4x SSAA  %.3f ms/frame, %.2f MiB", ssaaMs, ssaaBytes / 1048576.0);
     image.FlipVertically();
     image.Write("output.tga");
+    delete msaa;
     delete model;
+    return true;
+}
+
+// Times the clip stage against the viewport clamp alone on views where most of
+// the mesh is off screen (zoomed in on a point of the model at (0.3, 0.3)).
+bool RunClipBenchmark(const char* filename, uint32_t frames)
+{
+    Model* model = new Model();
+    if (!model->Load(filename)) {
+        ERRORF("can't load %s", filename);
+        delete model;
+        return false;
+    }
+    std::vector<float> intensities;
+    model->ComputeIntensities(Vec3f(0, 0, -1.f), intensities);
+    FrameBuffer fb(WIDTH, HEIGHT);
+
+    const float zooms[] = {1.f, 4.f, 16.f, 64.f, 256.f};
+    for (float zoom : zooms) {
+        const Vec3f pan(-0.3f * (zoom - 1.f), -0.3f * (zoom - 1.f), 0.f);
+        std::vector<Vec3f> corners(model->GetNumFaces() * 3);
+        uint32_t rejected = 0;
+        uint32_t clipped = 0;
+        for (uint32_t i = 0; i < model->GetNumFaces(); ++i) {
+            Vec4f clip_coords[3];
+            for (uint32_t j = 0; j < 3; ++j) {
+                Vec3f v = model->GetVert(model->GetFace(i)[j]);
+                corners[i * 3 + j] = Vec3f(v.x * zoom + pan.x, v.y * zoom + pan.y, v.z);
+                clip_coords[j] = Vec4f(corners[i * 3 + j], 1.f);
+            }
+            Vec4f polygon[MAX_CLIP_VERTS];
+            uint32_t count = ClipTriangle(clip_coords, polygon);
+            rejected += count == 0;
+            clipped += count > 0 && (count != 3 || polygon[0] != clip_coords[0] || polygon[1] != clip_coords[1] || polygon[2] != clip_coords[2]);
+        }
+
+        double ms[2];
+        for (int32_t clip = 0; clip < 2; ++clip) {
+            uint64_t start = GetTimeNs();
+            for (uint32_t f = 0; f < frames; ++f) {
+                fb.Clear();
+                for (uint32_t i = 0; i < model->GetNumFaces(); ++i) {
+                    DrawFace(&corners[i * 3], intensities[i], fb, clip != 0);
+                }
+            }
+            ms[clip] = (GetTimeNs() - start) / 1e6 / frames;
+        }
+        INFOF("zoom %5.1f: %5.1f%% rejected, %u clipped; clamp only %.3f ms, clip stage %.3f ms", zoom, 100.0 * rejected / model->GetNumFaces(), clipped, ms[0], ms[1]);
+    }
+    delete model;
+    return true;
+}
+
+// Crowd of one model on a square grid that overhangs the screen, so some
+// instances are culled; reports triangles per second at each instance count.
+bool RunInstancingBenchmark(const char* filename, uint32_t frames)
+{
+    Model* model = new Model();
+    if (!model->Load(filename)) {
+        ERRORF("can't load %s", filename);
+        delete model;
+        return false;
+    }
+    const uint32_t counts[] = {1, 100, 10000};
+    const Vec3f light_dir(0, 0, -1.f);
+    FrameBuffer fb(WIDTH, HEIGHT);
+    TGAImage image(WIDTH, HEIGHT, TGAFormat::RGB);
+    for (uint32_t count : counts) {
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+        float cell = (count == 1 ? 2.f : 3.f) / side;
+        float zoom = cell / 2.f / std::max(model->GetBoundsRadius(), 1e-6f);
+        std::vector<Instance> instances(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            Vec3f pan(cell * (i % side + 0.5f) - cell * side / 2.f, cell * (i / side + 0.5f) - cell * side / 2.f, 0.f);
+            instances[i].transform = MakeView(static_cast<float>(i * 37 % 360), zoom, pan - model->GetBoundsCenter() * zoom);
+            instances[i].color = count == 1 ? TGAColor(255, 255, 255, 255) : TGAColor(static_cast<uint8_t>(128 + i * 53 % 128), static_cast<uint8_t>(128 + i * 97 % 128), static_cast<uint8_t>(128 + i * 31 % 128), 255);
+        }
+        uint32_t drawn = 0;
+        uint64_t start = GetTimeNs();
+        for (uint32_t f = 0; f < frames; ++f) {
+            fb.Clear();
+            drawn = RenderInstances(*model, instances.data(), count, light_dir, fb);
+        }
+        double seconds = (GetTimeNs() - start) / 1e9 / frames;
+        double submitted = static_cast<double>(model->GetNumFaces()) * count;
+        INFOF("%5u instances (%5u culled): %9.3f ms/frame, %7.2f Mtris/s submitted, %7.2f Mtris/s drawn", count, count - drawn, seconds * 1e3, submitted / seconds / 1e6, submitted * drawn / count / seconds / 1e6);
+        if (count == 100) {
+            memcpy(image.GetData(), fb.GetImage().GetData(), WIDTH * HEIGHT * 3);
+        }
+    }
+    image.FlipVertically();
+    image.Write("output.tga");
+    delete model;
+    return true;
+}
+
+// Turntable of frames sent uncompressed to stdout (shmName == nullptr) or
+// published to the shared-memory frame ring shmName.
+bool RunFrameOutput(const char* filename, uint32_t frames, const char* shmName, DepthFormat depthFormat)
+{
+    if (shmName == nullptr) {
+        // stdout carries the frames.
+        SetInfoLogToStderr();
+    }
+    Model* model = new Model();
+    if (!model->Load(filename)) {
+        ERRORF("can't load %s", filename);
+        delete model;
+        return false;
+    }
+    ShmFrameWriter* ring = nullptr;
+    if (shmName != nullptr) {
+        ring = new ShmFrameWriter();
+        if (!ring->Create(shmName, SHM_RING_SLOTS, WIDTH * HEIGHT * 3)) {
+            delete ring;
+            delete model;
+            return false;
+        }
+    }
+    FrameBuffer fb(WIDTH, HEIGHT, depthFormat);
+    const Vec3f light_dir(0, 0, -1.f);
+    bool ok = true;
+    uint64_t start = GetTimeNs();
+    for (uint32_t f = 0; f < frames && ok; ++f) {
+        fb.Clear();
+        RenderModel(*model, MakeView(360.f * f / frames, 1.f, Vec3f()), light_dir, fb);
+        ok = ring != nullptr ? ring->Publish(fb.GetImage()) : WriteRawFrame(stdout, fb.GetImage());
+    }
+    double seconds = (GetTimeNs() - start) / 1e9;
+    INFOF("%u frames of %dx%d BGR in %.3f s (%.1f fps)", frames, WIDTH, HEIGHT, seconds, frames / seconds);
+    delete ring;
+    delete model;
+    return ok;
+}
+
+// Sample consumer of the frame ring: reads frames in place, checks each one
+// is still intact after use, and writes the last one to output.tga. Waits up
+// to a few seconds for the producer to appear and stops after frames frames
+// or once the producer has been idle for a second.
+bool RunFrameConsumer(const char* shmName, uint32_t frames)
+{
+    ShmFrameReader* reader = new ShmFrameReader();
+    uint64_t start = GetTimeNs();
+    while (!ShmFrameReader::Exists(shmName) || !reader->Open(shmName)) {
+        if (GetTimeNs() - start > 5000000000ull) {
+            delete reader;
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    uint32_t received = 0;
+    uint32_t torn = 0;
+    uint64_t bytes = 0;
+    uint64_t checksum = 0;
+    uint64_t idleSince = GetTimeNs();
+    start = idleSince;
+    FrameView frame;
+    FrameView newest;
+    while (received + torn + reader->GetNumDropped() < frames && GetTimeNs() - idleSince < 1000000000ull) {
+        if (!reader->Next(frame)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        idleSince = GetTimeNs();
+        // Stand-in for real work on the pixels: one byte per cache line.
+        for (size_t i = 0; i < frame.size; i += 64) {
+            checksum += frame.pixels[i];
+        }
+        if (!reader->IsIntact(frame)) {
+            ++torn;
+            continue;
+        }
+        ++received;
+        bytes += frame.size;
+        newest = frame;
+    }
+    double seconds = std::max((idleSince - start) / 1e9, 1e-9);
+    INFOF("received %u frames (%.1f fps, %.1f MiB/s), %llu dropped, %u torn, checksum %llu", received, received / seconds, bytes / 1048576.0 / seconds, static_cast<unsigned long long>(reader->GetNumDropped()), torn, static_cast<unsigned long long>(checksum));
+    if (received == 0) {
+        ERRORF("no frames received from %s", shmName);
+        delete reader;
+        return false;
+    }
+    // The ring holds rows top first, which is how Write stores them. Our
+    // mapping outlives the producer, so the newest frame is usually still there.
+    // Next checked that its size matches the image; the slot may have been
+    // reused since, before or during the copy.
+    TGAImage image(newest.width, newest.height, static_cast<TGAFormat>(newest.format));
+    if (reader->IsIntact(newest)) {
+        memcpy(image.GetData(), newest.pixels, newest.size);
+        if (reader->IsIntact(newest)) {
+            image.Write("output.tga");
+        }
+    }
+    delete reader;
+    return true;
+}
+
+static RenderServer* s_server = nullptr;
+
+static void OnStopSignal(int)
+{
+    if (s_server != nullptr) {
+        s_server->RequestStop();
+    }
+}
+
+bool RunServer(const char* socketPath, uint32_t numThreads, size_t cacheBudget, const char* modelDir, const char* outputDir)
+{
+    RenderServer* server = new RenderServer(cacheBudget);
+    if (!server->Start(socketPath, numThreads, SERVER_MAX_WIDTH, SERVER_MAX_HEIGHT, modelDir, outputDir)) {
+        delete server;
+        return false;
+    }
+    s_server = server;
+    signal(SIGINT, OnStopSignal);
+    signal(SIGTERM, OnStopSignal);
+    server->Run();
+    s_server = nullptr;
+    delete server;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* modelPath = "african_head.obj";
+    const char* benchSuite = nullptr;
+    const char* isa = nullptr;
+    DepthFormat depthFormat = DepthFormat::D24;
+    bool msaaOutput = false;
+    size_t streamBudget = 0;
+    uint32_t sweepFrames = 0;
+    uint32_t msaaFrames = 0;
+    uint32_t clipBenchFrames = 0;
+    uint32_t instancingFrames = 0;
+    uint32_t rawFrames = 0;
+    const char* shmName = nullptr;
+    uint32_t shmFrames = 0;
+    const char* consumeName = nullptr;
+    uint32_t consumeFrames = 0;
+    const char* servePath = nullptr;
+    const char* modelDir = ".";
+    const char* outputDir = nullptr;
+    const char* loadgenPath = nullptr;
+    uint32_t loadgenClients = 0;
+    uint32_t loadgenRequests = 0;
+    uint32_t numThreads = std::thread::hardware_concurrency();
+    size_t cacheBudget = SERVER_CACHE_BUDGET;
+    for (int32_t i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            benchSuite = argv[++i];
+        } else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+            isa = argv[++i];
+        } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            if (!ParseDepthFormat(argv[++i], depthFormat)) {
+                ERRORF("unknown depth format %s (d16, d24 or d32f)", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--aa") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "msaa") != 0 && strcmp(argv[i], "off") != 0) {
+                ERRORF("unknown antialiasing mode %s (off or msaa)", argv[i]);
+                return 1;
+            }
+            msaaOutput = strcmp(argv[i], "msaa") == 0;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            servePath = argv[++i];
+        } else if (strcmp(argv[i], "--model-dir") == 0 && i + 1 < argc) {
+            modelDir = argv[++i];
+        } else if (strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc) {
+            outputDir = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            numThreads = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cacheBudget = static_cast<size_t>(atof(argv[++i]) * 1024 * 1024);
+        } else if (strcmp(argv[i], "--loadgen") == 0 && i + 3 < argc) {
+            loadgenPath = argv[++i];
+            loadgenClients = static_cast<uint32_t>(atoi(argv[++i]));
+            loadgenRequests = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--clip-bench") == 0 && i + 1 < argc) {
+            clipBenchFrames = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--raw") == 0 && i + 1 < argc) {
+            rawFrames = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 2 < argc) {
+            shmName = argv[++i];
+            shmFrames = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--consume") == 0 && i + 2 < argc) {
+            consumeName = argv[++i];
+            consumeFrames = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instancingFrames = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) {
+            msaaFrames = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            sweepFrames = static_cast<uint32_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            streamBudget = static_cast<size_t>(atof(argv[++i]) * 1024 * 1024);
+        } else if (argv[i][0] == '-') {
+            ERRORF("usage: %s [--bench <suite|all>] [--isa <baseline|sse4.2|avx2|avx512>] [--depth <d16|d24|d32f>] [--aa <off|msaa>] [--stream <budget MiB>] [--sweep <frames>] [--msaa <frames>] [--clip-bench <frames>] [--instances <frames>] [--raw <frames>] [--shm <name> <frames>] [--consume <name> <frames>] [--serve <socket>] [--model-dir <dir>] [--out-dir <dir>] [--threads <n>] [--cache <budget MiB>] [--loadgen <socket> <clients> <requests>] [model.obj]", argv[0]);
+            return 1;
+        } else {
+            modelPath = argv[i];
+        }
+    }
+
+    if (isa != nullptr && !SelectKernels(isa)) {
+        ERRORF("kernel variant %s is unknown or not supported by this CPU", isa);
+        return 1;
+    }
+    if (benchSuite != nullptr) {
+        return RunBenchmark(benchSuite) ? 0 : 1;
+    }
+    if (servePath != nullptr) {
+        return RunServer(servePath, numThreads, cacheBudget, modelDir, outputDir) ? 0 : 1;
+    }
+    if (loadgenPath != nullptr) {
+        std::string request = std::string("model=") + modelPath + " width=256 height=256 yaw=30";
+        return RunLoadGenerator(loadgenPath, request, loadgenClients, loadgenRequests) ? 0 : 1;
+    }
+    if (sweepFrames > 0) {
+        return RunSweep(modelPath, sweepFrames) ? 0 : 1;
+    }
+    if (msaaFrames > 0) {
+        return RunMsaaComparison(modelPath, msaaFrames) ? 0 : 1;
+    }
+    if (clipBenchFrames > 0) {
+        return RunClipBenchmark(modelPath, clipBenchFrames) ? 0 : 1;
+    }
+    if (instancingFrames > 0) {
+        return RunInstancingBenchmark(modelPath, instancingFrames) ? 0 : 1;
+    }
+    if (rawFrames > 0) {
+        return RunFrameOutput(modelPath, rawFrames, nullptr, depthFormat) ? 0 : 1;
+    }
+    if (shmName != nullptr) {
+        return RunFrameOutput(modelPath, shmFrames, shmName, depthFormat) ? 0 : 1;
+    }
+    if (consumeName != nullptr) {
+        return RunFrameConsumer(consumeName, consumeFrames) ? 0 : 1;
+    }
+
+    Vec3f light_dir(0, 0, -1.f);
+    if (msaaOutput) {
+        if (streamBudget > 0) {
+            ERRORF("--aa msaa renders from a loaded model and can't be combined with --stream");
+            return 1;
+        }
+        TGAImage image(WIDTH, HEIGHT, TGAFormat::RGB);
+        if (!DrawModelMsaa(modelPath, image, light_dir)) {
+            return 1;
+        }
+        image.FlipVertically();
+        image.Write("output.tga");
+        return 0;
+    }
+    FrameBuffer fb(WIDTH, HEIGHT, depthFormat);
+    bool drawn = streamBudget > 0 ? DrawModelStreamed(modelPath, streamBudget, fb, light_dir) : DrawModel(modelPath, fb, light_dir);
+    if (!drawn) {
+        return 1;
+    }
+    fb.GetImage().FlipVertically();
+    fb.GetImage().Write("output.tga");
     return 0;
 }
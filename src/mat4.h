@@ -0,0 +1,122 @@
+﻿#pragma once
+
+#include "vec3.h"
+#include "vec4.h"
+
+// Row-major 4x4 matrix; vectors are columns, so Transform computes m * v.
+struct Mat4 final
+{
+    Mat4()
+    {
+        for (int32_t i = 0; i < 4; ++i) {
+            for (int32_t j = 0; j < 4; ++j) {
+                m[i][j] = i == j ? 1.f : 0.f;
+            }
+        }
+    }
+
+    Mat4(const Mat4& a)
+    {
+        *this = a;
+    }
+
+    Mat4& operator=(const Mat4& a)
+    {
+        for (int32_t i = 0; i < 4; ++i) {
+            for (int32_t j = 0; j < 4; ++j) {
+                m[i][j] = a.m[i][j];
+            }
+        }
+        return *this;
+    }
+
+    static Mat4 Identity()
+    {
+        return Mat4();
+    }
+
+    static Mat4 Translation(const Vec3f& t)
+    {
+        Mat4 r;
+        r.m[0][3] = t.x;
+        r.m[1][3] = t.y;
+        r.m[2][3] = t.z;
+        return r;
+    }
+
+    static Mat4 Scale(const Vec3f& s)
+    {
+        Mat4 r;
+        r.m[0][0] = s.x;
+        r.m[1][1] = s.y;
+        r.m[2][2] = s.z;
+        return r;
+    }
+
+    static Mat4 RotationY(float radians)
+    {
+        Mat4 r;
+        float c = std::cos(radians);
+        float s = std::sin(radians);
+        r.m[0][0] = c;
+        r.m[0][2] = s;
+        r.m[2][0] = -s;
+        r.m[2][2] = c;
+        return r;
+    }
+
+    // Maps [-1, 1]^3 to [x, x + w] x [y, y + h] x [0, depth].
+    static Mat4 Viewport(float x, float y, float w, float h, float depth)
+    {
+        Mat4 r;
+        r.m[0][0] = w / 2.f;
+        r.m[0][3] = x + w / 2.f;
+        r.m[1][1] = h / 2.f;
+        r.m[1][3] = y + h / 2.f;
+        r.m[2][2] = depth / 2.f;
+        r.m[2][3] = depth / 2.f;
+        return r;
+    }
+
+    Mat4 operator*(const Mat4& a) const
+    {
+        Mat4 r;
+        for (int32_t i = 0; i < 4; ++i) {
+            for (int32_t j = 0; j < 4; ++j) {
+                r.m[i][j] = m[i][0] * a.m[0][j] + m[i][1] * a.m[1][j] + m[i][2] * a.m[2][j] + m[i][3] * a.m[3][j];
+            }
+        }
+        return r;
+    }
+
+    Vec4f operator*(const Vec4f& v) const
+    {
+        return Vec4f(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z + m[0][3] * v.w,
+                     m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z + m[1][3] * v.w,
+                     m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z + m[2][3] * v.w,
+                     m[3][0] * v.x + m[3][1] * v.y + m[3][2] * v.z + m[3][3] * v.w);
+    }
+
+    Vec3f TransformPoint(const Vec3f& p) const
+    {
+        return (*this * Vec4f(p, 1.f)).PerspectiveDivide();
+    }
+
+    Vec3f TransformDir(const Vec3f& d) const
+    {
+        return (*this * Vec4f(d, 0.f)).Xyz();
+    }
+
+    Mat4 Transposed() const
+    {
+        Mat4 r;
+        for (int32_t i = 0; i < 4; ++i) {
+            for (int32_t j = 0; j < 4; ++j) {
+                r.m[i][j] = m[j][i];
+            }
+        }
+        return r;
+    }
+
+    float m[4][4];
+};
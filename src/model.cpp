@@ -1,5 +1,7 @@
 ﻿#include "model.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -20,29 +22,164 @@ bool Model::Load(const char* filename)
     }
 
     std::string line;
+    uint32_t numBadFaces = 0;
     while (!ifs.eof()) {
         std::getline(ifs, line);
-        std::istringstream iss(line);
-        char trash;
-        if (line.compare(0, 2, "v ") == 0) {
-            iss >> trash;
-            Vec3f v;
-            iss >> v.x;
-            iss >> v.y;
-            iss >> v.z;
+        Vec3f v;
+        std::vector<uint32_t> f;
+        if (ParseVert(line, v)) {
             m_verts.push_back(v);
-
-        } else if (line.compare(0, 2, "f ") == 0) {
-            std::vector<uint32_t> f;
-            int32_t itrash, index;
-            iss >> trash;
-            while (iss >> index >> trash >> itrash >> trash >> itrash) {
-                --index;
-                f.push_back(index);
+        } else if (ParseFace(line, GetNumVerts(), f)) {
+            if (f.empty()) {
+                ++numBadFaces;
+            } else {
+                m_faces.push_back(std::move(f));
             }
-            m_faces.push_back(std::move(f));
         }
     }
+    if (numBadFaces > 0) {
+        ERRORF("%s: skipped %u faces with fewer than 3 corners or bad vertex indices", filename, numBadFaces);
+    }
+    ComputeNormals();
+    ComputeTrianglesAndBounds();
     INFOF("# v# %zu f# %zu", m_verts.size(), m_faces.size());
     return true;
 }
+
+size_t Model::GetMemoryUsage() const
+{
+    size_t bytes = m_verts.capacity() * sizeof(Vec3f) + m_faces.capacity() * sizeof(std::vector<uint32_t>) + m_triangles.capacity() * sizeof(uint32_t);
+    for (const std::vector<uint32_t>& face : m_faces) {
+        bytes += face.capacity() * sizeof(uint32_t);
+    }
+    return bytes + m_faceNormals.GetMemoryUsage() + m_vertNormals.GetMemoryUsage();
+}
+
+void Model::ComputeIntensities(const Vec3f& lightDir, std::vector<float>& intensities) const
+{
+    ComputeIntensities(m_faceNormals, lightDir, intensities);
+}
+
+bool Model::ParseVert(const std::string& line, Vec3f& v)
+{
+    if (line.compare(0, 2, "v ") != 0) {
+        return false;
+    }
+    std::istringstream iss(line);
+    char trash;
+    iss >> trash;
+    iss >> v.x;
+    iss >> v.y;
+    iss >> v.z;
+    return true;
+}
+
+bool Model::ParseFace(const std::string& line, uint32_t numVerts, std::vector<uint32_t>& f)
+{
+    if (line.compare(0, 2, "f ") != 0) {
+        return false;
+    }
+    std::istringstream iss(line);
+    char trash;
+    int32_t itrash, index;
+    iss >> trash;
+    while (iss >> index >> trash >> itrash >> trash >> itrash) {
+        int64_t resolved = index < 0 ? static_cast<int64_t>(numVerts) + index : static_cast<int64_t>(index) - 1;
+        if (index == 0 || resolved < 0 || resolved >= numVerts) {
+            f.clear();
+            return true;
+        }
+        f.push_back(static_cast<uint32_t>(resolved));
+    }
+    if (f.size() < 3) {
+        f.clear();
+    }
+    return true;
+}
+
+void Model::ComputeFaceNormals(const Vec3f* corners, uint32_t numFaces, Vec3SoA& normals)
+{
+    normals.Resize(numFaces);
+    float ax[Floatx8::WIDTH], ay[Floatx8::WIDTH], az[Floatx8::WIDTH];
+    float bx[Floatx8::WIDTH], by[Floatx8::WIDTH], bz[Floatx8::WIDTH];
+    for (uint32_t i = 0; i < numFaces; i += Floatx8::WIDTH) {
+        for (uint32_t k = 0; k < Floatx8::WIDTH; ++k) {
+            const Vec3f* c = corners + (i + k < numFaces ? i + k : numFaces - 1) * 3;
+            Vec3f a = c[2] - c[0];
+            Vec3f b = c[1] - c[0];
+            ax[k] = a.x;
+            ay[k] = a.y;
+            az[k] = a.z;
+            bx[k] = b.x;
+            by[k] = b.y;
+            bz[k] = b.z;
+        }
+        Vec3x8f n = Vec3x8f::Load(ax, ay, az).Cross(Vec3x8f::Load(bx, by, bz));
+        n.Normalize();
+        normals.Store(i, n);
+    }
+}
+
+void Model::ComputeIntensities(const Vec3SoA& normals, const Vec3f& lightDir, std::vector<float>& intensities)
+{
+    intensities.resize(normals.x.size());
+    const Vec3x8f l(lightDir);
+    for (uint32_t i = 0; i < normals.GetSize(); i += Floatx8::WIDTH) {
+        normals.Load(i).Dot(l).Store(&intensities[i]);
+    }
+}
+
+void Model::ComputeNormals()
+{
+    uint32_t numFaces = GetNumFaces();
+    std::vector<Vec3f> corners(numFaces * 3);
+    for (uint32_t i = 0; i < numFaces; ++i) {
+        for (uint32_t j = 0; j < 3; ++j) {
+            corners[i * 3 + j] = m_verts[m_faces[i][j]];
+        }
+    }
+    ComputeFaceNormals(corners.data(), numFaces, m_faceNormals);
+
+    m_vertNormals.Resize(GetNumVerts());
+    for (uint32_t i = 0; i < numFaces; ++i) {
+        Vec3f n = m_faceNormals.Get(i);
+        for (uint32_t v : m_faces[i]) {
+            m_vertNormals.Set(v, m_vertNormals.Get(v) + n);
+        }
+    }
+    for (uint32_t i = 0; i < GetNumVerts(); i += Floatx8::WIDTH) {
+        Vec3x8f n = m_vertNormals.Load(i);
+        n.Normalize();
+        m_vertNormals.Store(i, n);
+    }
+}
+
+void Model::ComputeTrianglesAndBounds()
+{
+    // Load only keeps faces with at least three valid corners.
+    m_triangles.resize(m_faces.size() * 3);
+    for (uint32_t i = 0; i < GetNumFaces(); ++i) {
+        for (uint32_t j = 0; j < 3; ++j) {
+            m_triangles[i * 3 + j] = m_faces[i][j];
+        }
+    }
+
+    if (m_verts.empty()) {
+        m_boundsCenter = Vec3f();
+        m_boundsRadius = 0.f;
+        return;
+    }
+    Vec3f lo = m_verts[0];
+    Vec3f hi = m_verts[0];
+    for (const Vec3f& v : m_verts) {
+        lo = Vec3f(std::min(lo.x, v.x), std::min(lo.y, v.y), std::min(lo.z, v.z));
+        hi = Vec3f(std::max(hi.x, v.x), std::max(hi.y, v.y), std::max(hi.z, v.z));
+    }
+    m_boundsCenter = (lo + hi) * 0.5f;
+    float radiusSq = 0.f;
+    for (const Vec3f& v : m_verts) {
+        Vec3f d = v - m_boundsCenter;
+        radiusSq = std::max(radiusSq, d.Dot(d));
+    }
+    m_boundsRadius = std::sqrt(radiusSq);
+}
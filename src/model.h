@@ -1,8 +1,11 @@
 ﻿#pragma once
 
+#include <stdint.h>
+#include <string>
 #include <vector>
 
 #include "vec3.h"
+#include "vec3x8.h"
 
 class Model final
 {
@@ -15,8 +18,37 @@ public:
     uint32_t GetNumFaces() const { return static_cast<uint32_t>(m_faces.size()); }
     const Vec3f& GetVert(uint32_t i) const { return m_verts[i]; }
     const std::vector<uint32_t>& GetFace(uint32_t i) const { return m_faces[i]; }
+    // First three corners of every face, packed; shared by all instances.
+    const std::vector<uint32_t>& GetTriangles() const { return m_triangles; }
+    // Sphere around every vertex, in object space.
+    const Vec3f& GetBoundsCenter() const { return m_boundsCenter; }
+    float GetBoundsRadius() const { return m_boundsRadius; }
+    const Vec3SoA& GetFaceNormals() const { return m_faceNormals; }
+    const Vec3SoA& GetVertNormals() const { return m_vertNormals; }
+    void ComputeIntensities(const Vec3f& lightDir, std::vector<float>& intensities) const;
+    // Heap bytes held by vertex, index and normal data.
+    size_t GetMemoryUsage() const;
+
+    static bool ParseVert(const std::string& line, Vec3f& v);
+    // False if line is not a face. OBJ indices are 1-based, or relative to
+    // the end when negative, and resolved against the numVerts vertices read
+    // so far; f is left empty when a corner falls outside them or there are
+    // fewer than three corners.
+    static bool ParseFace(const std::string& line, uint32_t numVerts, std::vector<uint32_t>& f);
+    // corners holds three world-space vertices per face.
+    static void ComputeFaceNormals(const Vec3f* corners, uint32_t numFaces, Vec3SoA& normals);
+    static void ComputeIntensities(const Vec3SoA& normals, const Vec3f& lightDir, std::vector<float>& intensities);
+
+private:
+    void ComputeNormals();
+    void ComputeTrianglesAndBounds();
 
 private:
     std::vector<Vec3f> m_verts{};
     std::vector<std::vector<uint32_t>> m_faces{};
+    std::vector<uint32_t> m_triangles{};
+    Vec3f m_boundsCenter{};
+    float m_boundsRadius{};
+    Vec3SoA m_faceNormals{};
+    Vec3SoA m_vertNormals{};
 };
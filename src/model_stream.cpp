@@ -0,0 +1,204 @@
+﻿#include "model_stream.h"
+
+#include <string>
+
+#include "model.h"
+#include "util.h"
+
+static int32_t Seek64(FILE* fp, uint64_t offset)
+{
+#if defined(OS_WINDOWS)
+    return _fseeki64(fp, static_cast<int64_t>(offset), SEEK_SET);
+#else
+    return fseeko(fp, static_cast<off_t>(offset), SEEK_SET);
+#endif
+}
+
+VertexCache::VertexCache()
+{}
+
+VertexCache::~VertexCache()
+{
+    Close();
+}
+
+bool VertexCache::Open(size_t budgetBytes)
+{
+    Close();
+    m_fp = tmpfile();
+    if (m_fp == nullptr) {
+        ERRORF("can't create the vertex spill file");
+        return false;
+    }
+    size_t pageBytes = VERTS_PER_PAGE * sizeof(Vec3f);
+    m_maxPages = static_cast<uint32_t>(budgetBytes / pageBytes);
+    if (m_maxPages == 0) {
+        m_maxPages = 1;
+    }
+    m_writeBuffer.reserve(VERTS_PER_PAGE);
+    return true;
+}
+
+bool VertexCache::Append(const Vec3f& v)
+{
+    m_writeBuffer.push_back(v);
+    ++m_numVerts;
+    if (m_writeBuffer.size() == VERTS_PER_PAGE) {
+        return FlushWriteBuffer();
+    }
+    return true;
+}
+
+bool VertexCache::Seal()
+{
+    if (!FlushWriteBuffer()) {
+        return false;
+    }
+    m_writeBuffer.shrink_to_fit();
+    uint32_t numPages = (m_numVerts + VERTS_PER_PAGE - 1) / VERTS_PER_PAGE;
+    m_pageSlots.assign(numPages, -1);
+    if (m_maxPages > numPages) {
+        m_maxPages = numPages;
+    }
+    m_pages.clear();
+    m_pages.reserve(m_maxPages);
+    m_lru.clear();
+    return true;
+}
+
+Vec3f VertexCache::GetVert(uint32_t i)
+{
+    if (i >= m_numVerts) {
+        return Vec3f();
+    }
+    uint32_t index = i / VERTS_PER_PAGE;
+    Page* page = nullptr;
+    int32_t slot = m_pageSlots[index];
+    if (slot >= 0) {
+        page = &m_pages[slot];
+        m_lru.splice(m_lru.begin(), m_lru, page->lru);
+    } else {
+        page = LoadPage(index);
+        if (page == nullptr) {
+            return Vec3f();
+        }
+    }
+    return page->verts[i % VERTS_PER_PAGE];
+}
+
+void VertexCache::Close()
+{
+    if (m_fp != nullptr) {
+        fclose(m_fp);
+        m_fp = nullptr;
+    }
+    m_numVerts = 0;
+    m_numMisses = 0;
+    m_writeBuffer.clear();
+    m_pageSlots.clear();
+    m_pages.clear();
+    m_lru.clear();
+}
+
+bool VertexCache::FlushWriteBuffer()
+{
+    if (m_writeBuffer.empty()) {
+        return true;
+    }
+    if (fwrite(m_writeBuffer.data(), sizeof(Vec3f), m_writeBuffer.size(), m_fp) != m_writeBuffer.size()) {
+        ERRORF("can't write the vertex spill file");
+        return false;
+    }
+    m_writeBuffer.clear();
+    return true;
+}
+
+VertexCache::Page* VertexCache::LoadPage(uint32_t index)
+{
+    ++m_numMisses;
+    Page* page = nullptr;
+    if (m_pages.size() < m_maxPages) {
+        m_pages.emplace_back();
+        page = &m_pages.back();
+        page->verts.resize(VERTS_PER_PAGE);
+        m_lru.push_front(static_cast<uint32_t>(m_pages.size() - 1));
+        page->lru = m_lru.begin();
+    } else {
+        uint32_t slot = m_lru.back();
+        page = &m_pages[slot];
+        if (page->index != NO_PAGE) {
+            m_pageSlots[page->index] = -1;
+            page->index = NO_PAGE;
+        }
+        m_lru.splice(m_lru.begin(), m_lru, page->lru);
+    }
+
+    uint32_t first = index * VERTS_PER_PAGE;
+    uint32_t count = m_numVerts - first < VERTS_PER_PAGE ? m_numVerts - first : VERTS_PER_PAGE;
+    if (Seek64(m_fp, static_cast<uint64_t>(first) * sizeof(Vec3f)) != 0 || fread(page->verts.data(), sizeof(Vec3f), count, m_fp) != count) {
+        ERRORF("can't read page %u of the vertex spill file", index);
+        // The slot holds no page now; leave it to be reused first.
+        m_lru.splice(m_lru.end(), m_lru, page->lru);
+        return nullptr;
+    }
+    page->index = index;
+    m_pageSlots[index] = *page->lru;
+    return page;
+}
+
+ModelStream::ModelStream()
+{}
+
+ModelStream::~ModelStream()
+{}
+
+bool ModelStream::Open(const char* filename, size_t budgetBytes)
+{
+    m_ifs.close();
+    m_ifs.clear();
+    m_ifs.open(filename);
+    if (!m_ifs.is_open()) {
+        return false;
+    }
+    if (!m_cache.Open(budgetBytes)) {
+        return false;
+    }
+
+    std::string line;
+    while (!m_ifs.eof()) {
+        std::getline(m_ifs, line);
+        Vec3f v;
+        if (Model::ParseVert(line, v) && !m_cache.Append(v)) {
+            return false;
+        }
+    }
+    if (!m_cache.Seal()) {
+        return false;
+    }
+    m_ifs.clear();
+    m_ifs.seekg(0);
+    m_numVertsRead = 0;
+    INFOF("# v# %u pages %u", m_cache.GetNumVerts(), m_cache.GetMaxPages());
+    return true;
+}
+
+bool ModelStream::ReadFaces(std::vector<uint32_t>& tris, uint32_t maxFaces)
+{
+    tris.clear();
+    std::string line;
+    std::vector<uint32_t> f;
+    while (tris.size() < maxFaces * 3 && !m_ifs.eof()) {
+        std::getline(m_ifs, line);
+        if (line.compare(0, 2, "v ") == 0) {
+            ++m_numVertsRead;
+            continue;
+        }
+        f.clear();
+        if (Model::ParseFace(line, m_numVertsRead, f) && !f.empty()) {
+            tris.push_back(f[0]);
+            tris.push_back(f[1]);
+            tris.push_back(f[2]);
+        }
+    }
+    return !tris.empty();
+}
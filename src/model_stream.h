@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <fstream>
+#include <list>
+#include <vector>
+
+#include "vec3.h"
+
+// Vertex positions spilled to a temporary file and paged back in on demand.
+// At most budgetBytes worth of pages are resident at any time.
+class VertexCache final
+{
+public:
+    static const uint32_t VERTS_PER_PAGE = 4096;
+
+    VertexCache();
+    ~VertexCache();
+
+    bool Open(size_t budgetBytes);
+    bool Append(const Vec3f& v);
+    bool Seal();
+    Vec3f GetVert(uint32_t i);
+    uint32_t GetNumVerts() const { return m_numVerts; }
+    uint32_t GetMaxPages() const { return m_maxPages; }
+    uint64_t GetNumMisses() const { return m_numMisses; }
+
+private:
+    // Page::index of a slot that holds no page.
+    static constexpr uint32_t NO_PAGE = UINT32_MAX;
+
+    struct Page final
+    {
+        uint32_t index{NO_PAGE};
+        std::list<uint32_t>::iterator lru{};
+        std::vector<Vec3f> verts{};
+    };
+
+    void Close();
+    bool FlushWriteBuffer();
+    Page* LoadPage(uint32_t index);
+
+private:
+    FILE* m_fp{};
+    uint32_t m_numVerts{};
+    uint32_t m_maxPages{};
+    uint64_t m_numMisses{};
+    std::vector<Vec3f> m_writeBuffer{};
+    std::vector<int32_t> m_pageSlots{};
+    std::vector<Page> m_pages{};
+    std::list<uint32_t> m_lru{};
+};
+
+// Reads an OBJ file without expanding it into memory: vertices go through a
+// VertexCache and faces are handed out in bounded chunks of triangles.
+class ModelStream final
+{
+public:
+    ModelStream();
+    ~ModelStream();
+
+    bool Open(const char* filename, size_t budgetBytes);
+    bool ReadFaces(std::vector<uint32_t>& tris, uint32_t maxFaces);
+    Vec3f GetVert(uint32_t i) { return m_cache.GetVert(i); }
+    uint32_t GetNumVerts() const { return m_cache.GetNumVerts(); }
+    const VertexCache& GetCache() const { return m_cache; }
+
+private:
+    std::ifstream m_ifs{};
+    VertexCache m_cache{};
+    // Vertices ReadFaces has passed, for resolving face indices.
+    uint32_t m_numVertsRead{};
+};
@@ -0,0 +1,265 @@
+﻿#include "msaa.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
+
+#include "simd.h"
+
+// Rotated-grid sample positions within a pixel.
+static const float SAMPLE_X[MsaaTarget::SAMPLES] = {0.375f, 0.875f, 0.125f, 0.625f};
+static const float SAMPLE_Y[MsaaTarget::SAMPLES] = {0.125f, 0.375f, 0.625f, 0.875f};
+
+static const uint32_t NO_EDGE = 0xffffffffu;
+
+MsaaTarget::MsaaTarget(int32_t width, int32_t height)
+    : m_width(width)
+    , m_height(height)
+    , m_depth(width * height * SAMPLES)
+    , m_colors(width * height)
+    , m_masks(width * height)
+{
+    Clear(0);
+}
+
+MsaaTarget::~MsaaTarget()
+{}
+
+void MsaaTarget::Clear(uint32_t color)
+{
+    m_clearColor = color;
+    std::fill(m_depth.begin(), m_depth.end(), -std::numeric_limits<float>::infinity());
+    std::fill(m_colors.begin(), m_colors.end(), color);
+    std::fill(m_masks.begin(), m_masks.end(), 0);
+    m_edgeSamples.clear();
+    m_freeEdge = NO_EDGE;
+    m_numEdgePixels = 0;
+}
+
+void MsaaTarget::DrawTriangle(const Vec3f& p0, const Vec3f& p1, const Vec3f& p2, uint32_t color)
+{
+    Vec3f a = p0;
+    Vec3f b = p1;
+    Vec3f c = p2;
+    float area = (c.x - a.x) * (b.y - a.y) - (c.y - a.y) * (b.x - a.x);
+    if (area == 0.f) {
+        return;
+    }
+    if (area < 0.f) {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(std::min({a.x, b.x, c.x}))));
+    int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(std::min({a.y, b.y, c.y}))));
+    int32_t x1 = std::min(m_width - 1, static_cast<int32_t>(std::floor(std::max({a.x, b.x, c.x}))));
+    int32_t y1 = std::min(m_height - 1, static_cast<int32_t>(std::floor(std::max({a.y, b.y, c.y}))));
+
+    // Edge functions e(x, y) = ex * x + ey * y + ec, non-negative inside.
+    const Vec3f* v[3] = {&b, &c, &a};
+    const Vec3f* w[3] = {&c, &a, &b};
+    float ex[3], ey[3], ec[3];
+    for (int32_t e = 0; e < 3; ++e) {
+        ex[e] = w[e]->y - v[e]->y;
+        ey[e] = v[e]->x - w[e]->x;
+        ec[e] = -(ex[e] * v[e]->x + ey[e] * v[e]->y);
+    }
+    const float invArea = 1.f / area;
+
+#if defined(SIMD_AVX) || defined(SIMD_SSE)
+    // All four samples of a pixel in one register.
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sampleX = _mm_loadu_ps(SAMPLE_X);
+    const __m128 sampleY = _mm_loadu_ps(SAMPLE_Y);
+    __m128 vex[3], vey[3], vec[3];
+    for (int32_t e = 0; e < 3; ++e) {
+        vex[e] = _mm_set1_ps(ex[e]);
+        vey[e] = _mm_set1_ps(ey[e]);
+        vec[e] = _mm_set1_ps(ec[e]);
+    }
+    const __m128 za = _mm_set1_ps(a.z * invArea);
+    const __m128 zb = _mm_set1_ps(b.z * invArea);
+    const __m128 zc = _mm_set1_ps(c.z * invArea);
+#endif
+    for (int32_t y = y0; y <= y1; ++y) {
+#if defined(SIMD_AVX) || defined(SIMD_SSE)
+        __m128 sy = _mm_add_ps(_mm_set1_ps(static_cast<float>(y)), sampleY);
+        __m128 row0 = _mm_add_ps(_mm_mul_ps(vey[0], sy), vec[0]);
+        __m128 row1 = _mm_add_ps(_mm_mul_ps(vey[1], sy), vec[1]);
+        __m128 row2 = _mm_add_ps(_mm_mul_ps(vey[2], sy), vec[2]);
+#endif
+        for (int32_t x = x0; x <= x1; ++x) {
+            uint32_t pixel = x + y * m_width;
+            float* depth = &m_depth[pixel * SAMPLES];
+#if defined(SIMD_AVX) || defined(SIMD_SSE)
+            __m128 sx = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), sampleX);
+            __m128 l0 = _mm_add_ps(_mm_mul_ps(vex[0], sx), row0);
+            __m128 l1 = _mm_add_ps(_mm_mul_ps(vex[1], sx), row1);
+            __m128 l2 = _mm_add_ps(_mm_mul_ps(vex[2], sx), row2);
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(l0, zero), _mm_cmpge_ps(l1, zero)), _mm_cmpge_ps(l2, zero));
+            if (_mm_movemask_ps(inside) == 0) {
+                continue;
+            }
+            __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l0, za), _mm_mul_ps(l1, zb)), _mm_mul_ps(l2, zc));
+            __m128 old = _mm_loadu_ps(depth);
+            __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(old, z));
+            uint8_t samples = static_cast<uint8_t>(_mm_movemask_ps(pass));
+            _mm_storeu_ps(depth, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old)));
+#else
+            uint8_t samples = 0;
+            for (uint32_t s = 0; s < SAMPLES; ++s) {
+                float sx = x + SAMPLE_X[s];
+                float sy = y + SAMPLE_Y[s];
+                float l0 = ex[0] * sx + (ey[0] * sy + ec[0]);
+                float l1 = ex[1] * sx + (ey[1] * sy + ec[1]);
+                float l2 = ex[2] * sx + (ey[2] * sy + ec[2]);
+                if (l0 < 0.f || l1 < 0.f || l2 < 0.f) {
+                    continue;
+                }
+                float z = l0 * (a.z * invArea) + l1 * (b.z * invArea) + l2 * (c.z * invArea);
+                if (depth[s] < z) {
+                    depth[s] = z;
+                    samples |= 1 << s;
+                }
+            }
+#endif
+            if (samples != 0) {
+                WriteSamples(pixel, samples, color);
+            }
+        }
+    }
+}
+
+bool MsaaTarget::Resolve(TGAImage& image) const
+{
+    if (image.GetWidth() != static_cast<uint32_t>(m_width) || image.GetHeight() != static_cast<uint32_t>(m_height) || image.GetBytesPP() < 3) {
+        return false;
+    }
+    std::vector<uint32_t> resolved(m_width);
+    uint8_t* data = image.GetData();
+    uint32_t bytesPP = image.GetBytesPP();
+
+    for (int32_t y = 0; y < m_height; ++y) {
+        uint32_t rowStart = y * m_width;
+        int32_t x = 0;
+#if defined(SIMD_AVX) || defined(SIMD_SSE)
+        // Four pixels per step for runs without edge storage: expand each
+        // coverage bit into a color/clear select, widen to 16 bits and average.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i round = _mm_set1_epi16(SAMPLES / 2);
+        const __m128i clear = _mm_set1_epi32(static_cast<int32_t>(m_clearColor));
+        for (; x + 4 <= m_width; x += 4) {
+            uint32_t pixel = rowStart + x;
+            uint32_t packedMasks;
+            memcpy(&packedMasks, &m_masks[pixel], sizeof(packedMasks));
+            if ((packedMasks & (EDGE_FLAG * 0x01010101u)) != 0) {
+                for (int32_t i = 0; i < 4; ++i) {
+                    resolved[x + i] = ResolvePixel(pixel + i);
+                }
+                continue;
+            }
+            __m128i colors = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_colors[pixel]));
+            __m128i masks = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int32_t>(packedMasks)), zero), zero);
+            __m128i lo = round;
+            __m128i hi = round;
+            for (uint32_t s = 0; s < SAMPLES; ++s) {
+                __m128i bit = _mm_set1_epi32(1 << s);
+                __m128i sel = _mm_cmpeq_epi32(_mm_and_si128(masks, bit), bit);
+                __m128i c = _mm_or_si128(_mm_and_si128(sel, colors), _mm_andnot_si128(sel, clear));
+                lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(c, zero));
+                hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(c, zero));
+            }
+            lo = _mm_srli_epi16(lo, 2);
+            hi = _mm_srli_epi16(hi, 2);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&resolved[x]), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; x < m_width; ++x) {
+            resolved[x] = ResolvePixel(rowStart + x);
+        }
+
+        uint8_t* row = data + rowStart * bytesPP;
+        for (x = 0; x < m_width; ++x) {
+            memcpy(row + x * bytesPP, &resolved[x], bytesPP);
+        }
+    }
+    return true;
+}
+
+size_t MsaaTarget::GetMemoryUsage() const
+{
+    return m_depth.capacity() * sizeof(float) + m_colors.capacity() * sizeof(uint32_t) + m_masks.capacity() + m_edgeSamples.capacity() * sizeof(uint32_t);
+}
+
+void MsaaTarget::WriteSamples(uint32_t pixel, uint8_t samples, uint32_t color)
+{
+    uint8_t mask = m_masks[pixel];
+    if ((mask & EDGE_FLAG) == 0) {
+        if ((mask & ~samples) == 0 || m_colors[pixel] == color) {
+            // Still a single color: every sample is either this color or clear.
+            m_colors[pixel] = color;
+            m_masks[pixel] = mask | samples;
+            return;
+        }
+        uint32_t edge = AllocateEdge();
+        for (uint32_t s = 0; s < SAMPLES; ++s) {
+            m_edgeSamples[edge * SAMPLES + s] = (mask >> s) & 1 ? m_colors[pixel] : m_clearColor;
+        }
+        m_colors[pixel] = edge;
+        mask |= EDGE_FLAG;
+    } else if (samples == FULL_MASK) {
+        FreeEdge(m_colors[pixel]);
+        m_colors[pixel] = color;
+        m_masks[pixel] = FULL_MASK;
+        return;
+    }
+    uint32_t edge = m_colors[pixel];
+    for (uint32_t s = 0; s < SAMPLES; ++s) {
+        if ((samples >> s) & 1) {
+            m_edgeSamples[edge * SAMPLES + s] = color;
+        }
+    }
+    m_masks[pixel] = mask | samples;
+}
+
+uint32_t MsaaTarget::AllocateEdge()
+{
+    ++m_numEdgePixels;
+    if (m_freeEdge != NO_EDGE) {
+        uint32_t edge = m_freeEdge;
+        m_freeEdge = m_edgeSamples[edge * SAMPLES];
+        return edge;
+    }
+    m_edgeSamples.resize(m_edgeSamples.size() + SAMPLES);
+    return static_cast<uint32_t>(m_edgeSamples.size() / SAMPLES - 1);
+}
+
+void MsaaTarget::FreeEdge(uint32_t edge)
+{
+    --m_numEdgePixels;
+    m_edgeSamples[edge * SAMPLES] = m_freeEdge;
+    m_freeEdge = edge;
+}
+
+uint32_t MsaaTarget::ResolvePixel(uint32_t pixel) const
+{
+    uint32_t samples[SAMPLES];
+    bool edge = (m_masks[pixel] & EDGE_FLAG) != 0;
+    for (uint32_t s = 0; s < SAMPLES; ++s) {
+        if (edge) {
+            samples[s] = m_edgeSamples[m_colors[pixel] * SAMPLES + s];
+        } else {
+            samples[s] = (m_masks[pixel] >> s) & 1 ? m_colors[pixel] : m_clearColor;
+        }
+    }
+    uint32_t out = 0;
+    for (uint32_t byte = 0; byte < 4; ++byte) {
+        uint32_t sum = SAMPLES / 2;
+        for (uint32_t s = 0; s < SAMPLES; ++s) {
+            sum += (samples[s] >> (byte * 8)) & 0xff;
+        }
+        out |= (sum / SAMPLES) << (byte * 8);
+    }
+    return out;
+}
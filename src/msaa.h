@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "tga.h"
+#include "vec3.h"
+
+// 4x multisample render target. Depth is kept per sample, but color is
+// compressed per pixel: one color plus a mask of the samples it covers, with
+// four explicit sample colors allocated only for pixels on triangle edges.
+// An edge pixel's color word holds the index of its sample colors instead,
+// flagged by EDGE_FLAG in its mask, so a pixel costs 21 bytes plus 16 per
+// edge pixel. Edge slots freed by full coverage are reused before growing.
+class MsaaTarget final
+{
+public:
+    static constexpr uint32_t SAMPLES = 4;
+    static constexpr uint8_t FULL_MASK = (1 << SAMPLES) - 1;
+    static constexpr uint8_t EDGE_FLAG = 0x80;
+
+    MsaaTarget(int32_t width, int32_t height);
+    ~MsaaTarget();
+
+    void Clear(uint32_t color);
+    // Screen-space vertices, larger z is closer. color is shaded once by the
+    // caller and written to every covered sample that passes the depth test.
+    void DrawTriangle(const Vec3f& p0, const Vec3f& p1, const Vec3f& p2, uint32_t color);
+    // Box-filters the samples of every pixel into image (RGB or RGBA).
+    bool Resolve(TGAImage& image) const;
+
+    int32_t GetWidth() const { return m_width; }
+    int32_t GetHeight() const { return m_height; }
+    size_t GetMemoryUsage() const;
+    uint32_t GetNumEdgePixels() const { return m_numEdgePixels; }
+
+private:
+    void WriteSamples(uint32_t pixel, uint8_t samples, uint32_t color);
+    uint32_t AllocateEdge();
+    void FreeEdge(uint32_t edge);
+    uint32_t ResolvePixel(uint32_t pixel) const;
+
+private:
+    int32_t m_width{};
+    int32_t m_height{};
+    uint32_t m_clearColor{};
+    std::vector<float> m_depth{};
+    std::vector<uint32_t> m_colors{};
+    std::vector<uint8_t> m_masks{};
+    std::vector<uint32_t> m_edgeSamples{};
+    // Free edge slots form a list linked through their first sample.
+    uint32_t m_freeEdge{};
+    uint32_t m_numEdgePixels{};
+};
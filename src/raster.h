@@ -0,0 +1,122 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+
+#include "vec3.h"
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1).
+struct Rect final
+{
+    bool IsEmpty() const { return x0 >= x1 || y0 >= y1; }
+
+    bool Overlaps(const Rect& r) const
+    {
+        return x0 < r.x1 && r.x0 < x1 && y0 < r.y1 && r.y0 < y1;
+    }
+
+    Rect Intersect(const Rect& r) const
+    {
+        return Rect{std::max(x0, r.x0), std::max(y0, r.y0), std::min(x1, r.x1), std::min(y1, r.y1)};
+    }
+
+    Rect Union(const Rect& r) const
+    {
+        if (IsEmpty()) {
+            return r;
+        }
+        if (r.IsEmpty()) {
+            return *this;
+        }
+        return Rect{std::min(x0, r.x0), std::min(y0, r.y0), std::max(x1, r.x1), std::max(y1, r.y1)};
+    }
+
+    int32_t x0;
+    int32_t y0;
+    int32_t x1;
+    int32_t y1;
+};
+
+// [-1, 1]^3 to integer pixel coordinates and [0, depth].
+inline Vec3i NdcToScreen(const Vec3f& v, int32_t width, int32_t height, int32_t depth)
+{
+    return Vec3i(static_cast<int32_t>((v.x + 1.f) * width / 2), static_cast<int32_t>((v.y + 1.f) * height / 2), static_cast<int32_t>((v.z + 1.f) * depth / 2));
+}
+
+// Same mapping without truncation, for rasterizers that sample inside pixels.
+inline Vec3f NdcToScreenF(const Vec3f& v, int32_t width, int32_t height, int32_t depth)
+{
+    return Vec3f((v.x + 1.f) * width / 2, (v.y + 1.f) * height / 2, (v.z + 1.f) * depth / 2);
+}
+
+// Pixel bounds a triangle passed to RasterizeTriangle can touch.
+inline Rect TriangleBounds(const Vec3i& t0, const Vec3i& t1, const Vec3i& t2)
+{
+    return Rect{std::min({t0.x, t1.x, t2.x}), std::min({t0.y, t1.y, t2.y}), std::max({t0.x, t1.x, t2.x}) + 1, std::max({t0.y, t1.y, t2.y}) + 1};
+}
+
+// Scanline walk behind RasterizeTriangle: calls span(y, a, b, x0, x1) for
+// every row with a.x <= b.x the row's end points and [x0, x1) the covered
+// pixels inside clip. Coverage does not depend on clip, so rendering a frame as
+// several clipped passes gives the same result as one unclipped pass.
+template<typename F>
+void RasterizeSpans(Vec3i t0, Vec3i t1, Vec3i t2, const Rect& clip, F span)
+{
+    if (t0.y == t1.y && t0.y == t2.y) {
+        return;
+    }
+    if (t0.y > t1.y) {
+        std::swap(t0, t1);
+    }
+    if (t0.y > t2.y) {
+        std::swap(t0, t2);
+    }
+    if (t1.y > t2.y) {
+        std::swap(t1, t2);
+    }
+    int32_t total_height = t2.y - t0.y;
+    int32_t first = std::max(0, clip.y0 - t0.y);
+    int32_t last = std::min(total_height, clip.y1 - t0.y);
+    for (int32_t i = first; i < last; ++i) {
+        float alpha = static_cast<float>(i) / total_height;
+        Vec3i a = t0 + (t2 - t0) * alpha;
+        Vec3i b;
+        bool second_half = (i > t1.y - t0.y) || (t1.y == t0.y);
+        if (second_half) {
+            int32_t segment_height = t2.y - t1.y;
+            float beta = static_cast<float>(i - (t1.y - t0.y)) / segment_height;
+            b = t1 + (t2 - t1) * beta;
+        } else {
+            int32_t segment_height = t1.y - t0.y;
+            float beta = static_cast<float>(i) / segment_height;
+            b = t0 + (t1 - t0) * beta;
+        }
+        if (a.x > b.x) {
+            std::swap(a, b);
+        }
+        int32_t y = t0.y + i;  // a hack to fill holes (due to int cast precision problems)
+        int32_t x0 = std::max(a.x, clip.x0);
+        int32_t x1 = std::min(b.x, clip.x1);
+        if (x0 < x1) {
+            span(y, a, b, x0, x1);
+        }
+    }
+}
+
+// Depth at pixel x of a span; a.x <= x < b.x.
+inline int32_t SpanDepth(const Vec3i& a, const Vec3i& b, int32_t x)
+{
+    float phi = static_cast<float>(x - a.x) / static_cast<float>(b.x - a.x);
+    return a.z + static_cast<int32_t>((b.z - a.z) * phi);
+}
+
+// Scanline rasterizer; calls plot(x, y, z) for every covered pixel inside clip.
+template<typename F>
+void RasterizeTriangle(const Vec3i& t0, const Vec3i& t1, const Vec3i& t2, const Rect& clip, F plot)
+{
+    RasterizeSpans(t0, t1, t2, clip, [&](int32_t y, const Vec3i& a, const Vec3i& b, int32_t x0, int32_t x1) {
+        for (int32_t x = x0; x < x1; ++x) {
+            plot(x, y, SpanDepth(a, b, x));
+        }
+    });
+}
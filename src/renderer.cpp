@@ -0,0 +1,182 @@
+﻿#include "renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+#include "clip.h"
+#include "kernels.h"
+#include "raster.h"
+
+// The kernels take vertices as packed xyz floats.
+static_assert(sizeof(Vec3f) == 3 * sizeof(float), "Vec3f must be tightly packed");
+
+FrameBuffer::FrameBuffer(int32_t width, int32_t height, DepthFormat depthFormat)
+    : m_width(width)
+    , m_height(height)
+    , m_depth(width, height, depthFormat)
+    , m_image(width, height, TGAFormat::RGB)
+{
+    Clear();
+}
+
+FrameBuffer::~FrameBuffer()
+{}
+
+void FrameBuffer::Reset(int32_t width, int32_t height)
+{
+    m_width = width;
+    m_height = height;
+    m_depth.Reset(width, height, m_depth.GetFormat());
+    m_image.Reset(width, height, TGAFormat::RGB);
+    Clear();
+}
+
+void FrameBuffer::Clear()
+{
+    m_depth.Clear();
+    memset(m_image.GetData(), 0, m_width * m_height * m_image.GetBytesPP());
+}
+
+Mat4 MakeView(float yawDegrees, float zoom, const Vec3f& pan)
+{
+    return Mat4::Translation(pan) * Mat4::Scale(Vec3f(zoom)) * Mat4::RotationY(yawDegrees * 3.14159265f / 180.f);
+}
+
+// z is each vertex's unquantized depth in [0, 1], for D32F.
+static void DrawScreenTriangle(const Vec3i& t0, const Vec3i& t1, const Vec3i& t2, const float z[3], FrameBuffer& fb, const TGAColor& color)
+{
+    const int32_t tri[9] = {t0.x, t0.y, t0.z, t1.x, t1.y, t1.z, t2.x, t2.y, t2.z};
+    TGAImage& image = fb.GetImage();
+    GetKernels().drawTriangle(tri, z, fb.GetDepth().GetTarget(), image.GetData(), fb.GetWidth(), fb.GetHeight(), image.GetBytesPP(), color.val);
+}
+
+void DrawTriangle(const Vec3i& t0, const Vec3i& t1, const Vec3i& t2, FrameBuffer& fb, const TGAColor& color)
+{
+    const float range = static_cast<float>(fb.GetDepth().GetRange());
+    const float z[3] = {t0.z / range, t1.z / range, t2.z / range};
+    DrawScreenTriangle(t0, t1, t2, z, fb, color);
+}
+
+// DrawFace with the shade already applied to color.
+static void DrawShadedFace(const Vec3f world_coords[3], const TGAColor& color, FrameBuffer& fb, bool clip)
+{
+    Vec3f ndc[MAX_CLIP_VERTS];
+    uint32_t count = 3;
+    if (clip) {
+        Vec4f clip_coords[3] = {Vec4f(world_coords[0], 1.f), Vec4f(world_coords[1], 1.f), Vec4f(world_coords[2], 1.f)};
+        Vec4f polygon[MAX_CLIP_VERTS];
+        count = ClipTriangle(clip_coords, polygon);
+        for (uint32_t i = 0; i < count; ++i) {
+            ndc[i] = polygon[i].PerspectiveDivide();
+        }
+    } else {
+        for (uint32_t i = 0; i < count; ++i) {
+            ndc[i] = world_coords[i];
+        }
+    }
+    Vec3i screen_coords[MAX_CLIP_VERTS];
+    float z[MAX_CLIP_VERTS];
+    for (uint32_t i = 0; i < count; ++i) {
+        screen_coords[i] = NdcToScreen(ndc[i], fb.GetWidth(), fb.GetHeight(), fb.GetDepth().GetRange());
+        z[i] = (ndc[i].z + 1.f) * 0.5f;
+    }
+    for (uint32_t i = 2; i < count; ++i) {
+        const float triZ[3] = {z[0], z[i - 1], z[i]};
+        DrawScreenTriangle(screen_coords[0], screen_coords[i - 1], screen_coords[i], triZ, fb, color);
+    }
+}
+
+void DrawFace(const Vec3f world_coords[3], float intensity, FrameBuffer& fb, bool clip)
+{
+    if (intensity <= 0) {
+        return;
+    }
+    TGAColor color(static_cast<uint8_t>(intensity * 255), static_cast<uint8_t>(intensity * 255), static_cast<uint8_t>(intensity * 255), 255);
+    DrawShadedFace(world_coords, color, fb, clip);
+}
+
+void RenderModel(const Model& model, const Mat4& view, const Vec3f& lightDir, FrameBuffer& fb)
+{
+    Instance instance{view, TGAColor(255, 255, 255, 255)};
+    RenderInstances(model, &instance, 1, lightDir, fb);
+}
+
+void DrawFace(const Vec3f world_coords[3], float intensity, MsaaTarget& target)
+{
+    if (intensity <= 0) {
+        return;
+    }
+    uint8_t c = static_cast<uint8_t>(intensity * 255);
+    Vec4f clip_coords[3] = {Vec4f(world_coords[0], 1.f), Vec4f(world_coords[1], 1.f), Vec4f(world_coords[2], 1.f)};
+    Vec4f polygon[MAX_CLIP_VERTS];
+    uint32_t count = ClipTriangle(clip_coords, polygon);
+    Vec3f screen_coords[MAX_CLIP_VERTS];
+    for (uint32_t i = 0; i < count; ++i) {
+        screen_coords[i] = NdcToScreenF(polygon[i].PerspectiveDivide(), target.GetWidth(), target.GetHeight(), DEPTH);
+    }
+    for (uint32_t i = 2; i < count; ++i) {
+        target.DrawTriangle(screen_coords[0], screen_coords[i - 1], screen_coords[i], TGAColor(c, c, c, 255).val);
+    }
+}
+
+void RenderModel(const Model& model, const Mat4& view, const Vec3f& lightDir, MsaaTarget& target)
+{
+    const uint32_t* triangles = model.GetTriangles().data();
+    std::vector<Vec3f> transformed(model.GetNumVerts());
+    std::vector<float> intensities;
+    Vec3f objectLight = view.Transposed().TransformDir(lightDir);
+    objectLight.Normalize();
+    model.ComputeIntensities(objectLight, intensities);
+    if (!transformed.empty()) {
+        GetKernels().transformPoints(&view.m[0][0], &model.GetVert(0).x, model.GetNumVerts(), &transformed[0].x);
+    }
+    for (uint32_t i = 0; i < model.GetNumFaces(); ++i) {
+        const uint32_t* face = triangles + i * 3;
+        const Vec3f world_coords[3] = {transformed[face[0]], transformed[face[1]], transformed[face[2]]};
+        DrawFace(world_coords, intensities[i], target);
+    }
+}
+
+uint32_t RenderInstances(const Model& model, const Instance* instances, uint32_t count, const Vec3f& lightDir, FrameBuffer& fb)
+{
+    const uint32_t* triangles = model.GetTriangles().data();
+    std::vector<Vec3f> transformed(model.GetNumVerts());
+    std::vector<float> intensities;
+    uint32_t drawn = 0;
+    for (uint32_t n = 0; n < count; ++n) {
+        const Mat4& view = instances[n].transform;
+        // The view is a similarity transform, so the sphere stays a sphere
+        // with its radius scaled by the length of any basis column.
+        Vec3f center = view.TransformPoint(model.GetBoundsCenter());
+        float radius = model.GetBoundsRadius() * view.TransformDir(Vec3f(1.f, 0.f, 0.f)).Magnitude();
+        float reach = std::max({std::fabs(center.x), std::fabs(center.y), std::fabs(center.z)});
+        if (reach - radius > 1.f) {
+            continue;
+        }
+        ++drawn;
+        bool clip = reach + radius > 1.f;
+
+        // Flat shading only needs n . l, so light the untransformed normals
+        // with the light rotated back into object space.
+        Vec3f objectLight = view.Transposed().TransformDir(lightDir);
+        objectLight.Normalize();
+        model.ComputeIntensities(objectLight, intensities);
+        // Each vertex once, instead of once per face that uses it.
+        if (!transformed.empty()) {
+            GetKernels().transformPoints(&view.m[0][0], &model.GetVert(0).x, model.GetNumVerts(), &transformed[0].x);
+        }
+        const TGAColor& tint = instances[n].color;
+        for (uint32_t i = 0; i < model.GetNumFaces(); ++i) {
+            float intensity = intensities[i];
+            if (intensity <= 0) {
+                continue;
+            }
+            const uint32_t* face = triangles + i * 3;
+            const Vec3f world_coords[3] = {transformed[face[0]], transformed[face[1]], transformed[face[2]]};
+            TGAColor color(static_cast<uint8_t>(tint.r * intensity), static_cast<uint8_t>(tint.g * intensity), static_cast<uint8_t>(tint.b * intensity), 255);
+            DrawShadedFace(world_coords, color, fb, clip);
+        }
+    }
+    return drawn;
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "depth_buffer.h"
+#include "mat4.h"
+#include "model.h"
+#include "msaa.h"
+#include "tga.h"
+#include "vec3.h"
+
+static const int32_t DEPTH = 255;
+
+// Color and depth targets for one frame. Reset reuses the allocations when the
+// new size fits, so long-lived frame buffers don't reallocate per frame.
+class FrameBuffer final
+{
+public:
+    FrameBuffer(int32_t width, int32_t height, DepthFormat depthFormat = DepthFormat::D24);
+    ~FrameBuffer();
+
+    void Reset(int32_t width, int32_t height);
+    void Clear();
+    int32_t GetWidth() const { return m_width; }
+    int32_t GetHeight() const { return m_height; }
+    DepthBuffer& GetDepth() { return m_depth; }
+    TGAImage& GetImage() { return m_image; }
+
+private:
+    int32_t m_width{};
+    int32_t m_height{};
+    DepthBuffer m_depth;
+    TGAImage m_image;
+};
+
+// Camera as an object-to-NDC matrix: rotation about y, uniform zoom, then pan.
+Mat4 MakeView(float yawDegrees, float zoom, const Vec3f& pan);
+
+// Screen-space z in [0, fb.GetDepth().GetRange()]; D32F stores it scaled to
+// [0, 1] rather than quantized further.
+void DrawTriangle(const Vec3i& t0, const Vec3i& t1, const Vec3i& t2, FrameBuffer& fb, const TGAColor& color);
+// Faces go through the clip stage first: trivially rejected when entirely off
+// screen, clipped only when they cross the guard band, and otherwise left to
+// the rasterizer's viewport clamp. clip = false skips straight to the clamp.
+void DrawFace(const Vec3f world_coords[3], float intensity, FrameBuffer& fb, bool clip = true);
+// view must be a rotation, uniform scale and translation; lightDir is in view space.
+void RenderModel(const Model& model, const Mat4& view, const Vec3f& lightDir, FrameBuffer& fb);
+
+// The same flat-shaded face into a 4x MSAA target, shaded once per pixel and
+// always put through the clip stage.
+void DrawFace(const Vec3f world_coords[3], float intensity, MsaaTarget& target);
+// RenderModel into a 4x MSAA target; Resolve it to get the image.
+void RenderModel(const Model& model, const Mat4& view, const Vec3f& lightDir, MsaaTarget& target);
+
+// One copy of a model in RenderInstances. transform is an object-to-NDC view
+// as for RenderModel; each face is drawn in color scaled by its shade.
+struct Instance final
+{
+    Mat4 transform;
+    TGAColor color;
+};
+
+// Draws model once per instance, sharing its index buffer and face normals.
+// Instances whose bounding sphere misses the view volume are culled before any
+// vertex work; the rest are transformed and lit one batch per instance, and
+// skip the clip stage when the sphere lies inside the view. Returns the number
+// of instances not culled.
+uint32_t RenderInstances(const Model& model, const Instance* instances, uint32_t count, const Vec3f& lightDir, FrameBuffer& fb);
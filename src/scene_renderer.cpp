@@ -0,0 +1,291 @@
+﻿#include "scene_renderer.h"
+
+#include <cmath>
+#include <limits>
+
+SceneRenderer::SceneRenderer(int32_t width, int32_t height, int32_t depth)
+    : m_width(width)
+    , m_height(height)
+    , m_depth(depth)
+    , m_tilesX((width + TILE_SIZE - 1) / TILE_SIZE)
+    , m_tilesY((height + TILE_SIZE - 1) / TILE_SIZE)
+    , m_image(width, height, TGAFormat::RGB)
+    , m_zbuffer(width * height, std::numeric_limits<int32_t>::min())
+    , m_triangleIds(width * height, NO_TRIANGLE)
+    , m_lightDir(0.f, 0.f, -1.f)
+{
+    m_dirtyTiles.assign(m_tilesX * m_tilesY, 0);
+}
+
+SceneRenderer::~SceneRenderer()
+{}
+
+uint32_t SceneRenderer::AddObject(const Model* model, float scale, const Vec3f& offset)
+{
+    Object obj;
+    obj.model = model;
+    obj.scale = scale;
+    obj.offset = offset;
+    obj.firstTriangle = m_numTriangles;
+
+    // Back faces are culled against the view direction rather than the light,
+    // so the ID buffer stays valid when only the light moves.
+    std::vector<float> facing;
+    model->ComputeIntensities(Vec3f(0.f, 0.f, -1.f), facing);
+    obj.visible.resize(model->GetNumFaces());
+    for (uint32_t i = 0; i < model->GetNumFaces(); ++i) {
+        obj.visible[i] = facing[i] > 0 && model->GetFace(i).size() >= 3;
+    }
+    TransformObject(obj);
+
+    m_numTriangles += model->GetNumFaces();
+    m_objects.push_back(std::move(obj));
+    // Shade the new triangles now so m_shades always covers every triangle,
+    // whether or not Render has run; its pixels are drawn via the dirty tiles.
+    m_shades.resize(m_numTriangles);
+    ComputeObjectShades(m_objects.back(), m_shades);
+    MarkDirty(m_objects.back().bounds);
+    return static_cast<uint32_t>(m_objects.size() - 1);
+}
+
+void SceneRenderer::MoveObject(uint32_t object, const Vec3f& offset)
+{
+    Object& obj = m_objects[object];
+    MarkDirty(obj.bounds);
+    obj.offset = offset;
+    TransformObject(obj);
+    MarkDirty(obj.bounds);
+}
+
+void SceneRenderer::SetLight(const Vec3f& lightDir)
+{
+    m_lightDir = lightDir;
+    m_lightDirty = true;
+}
+
+void SceneRenderer::Render()
+{
+    const Rect screen{0, 0, m_width, m_height};
+    std::fill(m_zbuffer.begin(), m_zbuffer.end(), std::numeric_limits<int32_t>::min());
+    std::fill(m_triangleIds.begin(), m_triangleIds.end(), NO_TRIANGLE);
+    for (const Object& obj : m_objects) {
+        RasterizeObject(obj, screen);
+    }
+    ComputeShades(m_shades);
+    m_numShadedPixels = 0;
+    ShadePixels(screen, nullptr);
+    std::fill(m_dirtyTiles.begin(), m_dirtyTiles.end(), 0);
+    m_lightDirty = false;
+}
+
+uint32_t SceneRenderer::Update()
+{
+    m_numShadedPixels = 0;
+    if (m_lightDirty) {
+        std::vector<uint8_t> shades;
+        ComputeShades(shades);
+        std::vector<uint8_t> changed(m_numTriangles);
+        for (uint32_t i = 0; i < m_numTriangles; ++i) {
+            changed[i] = shades[i] != m_shades[i];
+        }
+        m_shades.swap(shades);
+        ShadePixels(Rect{0, 0, m_width, m_height}, &changed);
+        m_lightDirty = false;
+    }
+
+    uint32_t numDirty = 0;
+    Rect dirty{0, 0, 0, 0};
+    for (int32_t ty = 0; ty < m_tilesY; ++ty) {
+        for (int32_t tx = 0; tx < m_tilesX; ++tx) {
+            if (!m_dirtyTiles[tx + ty * m_tilesX]) {
+                continue;
+            }
+            Rect tile = GetTileRect(tx, ty);
+            for (int32_t y = tile.y0; y < tile.y1; ++y) {
+                std::fill(&m_zbuffer[tile.x0 + y * m_width], &m_zbuffer[tile.x1 + y * m_width], std::numeric_limits<int32_t>::min());
+                std::fill(&m_triangleIds[tile.x0 + y * m_width], &m_triangleIds[tile.x1 + y * m_width], NO_TRIANGLE);
+            }
+            dirty = dirty.Union(tile);
+            ++numDirty;
+        }
+    }
+    if (numDirty == 0) {
+        return 0;
+    }
+    for (const Object& obj : m_objects) {
+        if (obj.bounds.Overlaps(dirty)) {
+            RasterizeDirtyTiles(obj, dirty);
+        }
+    }
+    for (int32_t ty = 0; ty < m_tilesY; ++ty) {
+        for (int32_t tx = 0; tx < m_tilesX; ++tx) {
+            if (m_dirtyTiles[tx + ty * m_tilesX]) {
+                ShadePixels(GetTileRect(tx, ty), nullptr);
+                m_dirtyTiles[tx + ty * m_tilesX] = 0;
+            }
+        }
+    }
+    return numDirty;
+}
+
+void SceneRenderer::TransformObject(Object& obj)
+{
+    const Model* model = obj.model;
+    obj.screenVerts.resize(model->GetNumVerts());
+    obj.worldVerts.resize(model->GetNumVerts());
+    Rect bounds{0, 0, 0, 0};
+    bool clip = false;
+    for (uint32_t i = 0; i < model->GetNumVerts(); ++i) {
+        Vec3f v = model->GetVert(i) * obj.scale + obj.offset;
+        clip = clip || std::fabs(v.x) > GUARD_BAND || std::fabs(v.y) > GUARD_BAND || std::fabs(v.z) > 1.f;
+        obj.worldVerts[i] = v;
+        // Clamping each axis to the guard band clamps the bounds the same way,
+        // which keeps them in pixel range and still covers the visible part.
+        v = Vec3f(std::min(std::max(v.x, -GUARD_BAND), GUARD_BAND), std::min(std::max(v.y, -GUARD_BAND), GUARD_BAND), v.z);
+        Vec3i p = NdcToScreen(v, m_width, m_height, m_depth);
+        obj.screenVerts[i] = p;
+        bounds = bounds.Union(Rect{p.x, p.y, p.x + 1, p.y + 1});
+    }
+    if (!clip) {
+        obj.worldVerts.clear();
+    }
+    obj.bounds = bounds.Intersect(Rect{0, 0, m_width, m_height});
+}
+
+void SceneRenderer::MarkDirty(const Rect& r)
+{
+    Rect clipped = r.Intersect(Rect{0, 0, m_width, m_height});
+    if (clipped.IsEmpty()) {
+        return;
+    }
+    for (int32_t ty = clipped.y0 / TILE_SIZE; ty <= (clipped.y1 - 1) / TILE_SIZE; ++ty) {
+        for (int32_t tx = clipped.x0 / TILE_SIZE; tx <= (clipped.x1 - 1) / TILE_SIZE; ++tx) {
+            m_dirtyTiles[tx + ty * m_tilesX] = 1;
+        }
+    }
+}
+
+uint32_t SceneRenderer::GetScreenPolygon(const Object& obj, uint32_t face, Vec3i poly[MAX_CLIP_VERTS]) const
+{
+    const std::vector<uint32_t>& verts = obj.model->GetFace(face);
+    if (obj.worldVerts.empty()) {
+        poly[0] = obj.screenVerts[verts[0]];
+        poly[1] = obj.screenVerts[verts[1]];
+        poly[2] = obj.screenVerts[verts[2]];
+        return 3;
+    }
+    Vec4f clip_coords[3] = {Vec4f(obj.worldVerts[verts[0]], 1.f), Vec4f(obj.worldVerts[verts[1]], 1.f), Vec4f(obj.worldVerts[verts[2]], 1.f)};
+    Vec4f polygon[MAX_CLIP_VERTS];
+    uint32_t count = ClipTriangle(clip_coords, polygon);
+    for (uint32_t i = 0; i < count; ++i) {
+        poly[i] = NdcToScreen(polygon[i].PerspectiveDivide(), m_width, m_height, m_depth);
+    }
+    return count;
+}
+
+void SceneRenderer::RasterizeObject(const Object& obj, const Rect& clip)
+{
+    const Model* model = obj.model;
+    Vec3i poly[MAX_CLIP_VERTS];
+    for (uint32_t i = 0; i < model->GetNumFaces(); ++i) {
+        if (!obj.visible[i]) {
+            continue;
+        }
+        uint32_t count = GetScreenPolygon(obj, i, poly);
+        uint32_t id = obj.firstTriangle + i;
+        for (uint32_t k = 2; k < count; ++k) {
+            const Vec3i& t0 = poly[0];
+            const Vec3i& t1 = poly[k - 1];
+            const Vec3i& t2 = poly[k];
+            if (!TriangleBounds(t0, t1, t2).Overlaps(clip)) {
+                continue;
+            }
+            RasterizeTriangle(t0, t1, t2, clip, [&](int32_t x, int32_t y, int32_t z) {
+                int32_t idx = x + y * m_width;
+                if (m_zbuffer[idx] < z) {
+                    m_zbuffer[idx] = z;
+                    m_triangleIds[idx] = id;
+                }
+            });
+        }
+    }
+}
+
+// Objects outer, faces inner, tiles innermost: every pixel still sees its
+// triangles in the same order as a full Render, so depth ties resolve the same.
+void SceneRenderer::RasterizeDirtyTiles(const Object& obj, const Rect& dirty)
+{
+    const Model* model = obj.model;
+    Vec3i poly[MAX_CLIP_VERTS];
+    for (uint32_t i = 0; i < model->GetNumFaces(); ++i) {
+        if (!obj.visible[i]) {
+            continue;
+        }
+        uint32_t count = GetScreenPolygon(obj, i, poly);
+        uint32_t id = obj.firstTriangle + i;
+        for (uint32_t k = 2; k < count; ++k) {
+            const Vec3i& t0 = poly[0];
+            const Vec3i& t1 = poly[k - 1];
+            const Vec3i& t2 = poly[k];
+            Rect bounds = TriangleBounds(t0, t1, t2).Intersect(dirty);
+            if (bounds.IsEmpty()) {
+                continue;
+            }
+            for (int32_t ty = bounds.y0 / TILE_SIZE; ty <= (bounds.y1 - 1) / TILE_SIZE; ++ty) {
+                for (int32_t tx = bounds.x0 / TILE_SIZE; tx <= (bounds.x1 - 1) / TILE_SIZE; ++tx) {
+                    if (!m_dirtyTiles[tx + ty * m_tilesX]) {
+                        continue;
+                    }
+                    RasterizeTriangle(t0, t1, t2, GetTileRect(tx, ty), [&](int32_t x, int32_t y, int32_t z) {
+                        int32_t idx = x + y * m_width;
+                        if (m_zbuffer[idx] < z) {
+                            m_zbuffer[idx] = z;
+                            m_triangleIds[idx] = id;
+                        }
+                    });
+                }
+            }
+        }
+    }
+}
+
+Rect SceneRenderer::GetTileRect(int32_t tx, int32_t ty) const
+{
+    return Rect{tx * TILE_SIZE, ty * TILE_SIZE, std::min((tx + 1) * TILE_SIZE, m_width), std::min((ty + 1) * TILE_SIZE, m_height)};
+}
+
+void SceneRenderer::ComputeShades(std::vector<uint8_t>& shades) const
+{
+    shades.resize(m_numTriangles);
+    for (const Object& obj : m_objects) {
+        ComputeObjectShades(obj, shades);
+    }
+}
+
+void SceneRenderer::ComputeObjectShades(const Object& obj, std::vector<uint8_t>& shades) const
+{
+    std::vector<float> intensities;
+    obj.model->ComputeIntensities(m_lightDir, intensities);
+    for (uint32_t i = 0; i < obj.model->GetNumFaces(); ++i) {
+        shades[obj.firstTriangle + i] = intensities[i] > 0 ? static_cast<uint8_t>(intensities[i] * 255) : 0;
+    }
+}
+
+void SceneRenderer::ShadePixels(const Rect& r, const std::vector<uint8_t>* changed)
+{
+    uint8_t* data = m_image.GetData();
+    for (int32_t y = r.y0; y < r.y1; ++y) {
+        for (int32_t x = r.x0; x < r.x1; ++x) {
+            uint32_t id = m_triangleIds[x + y * m_width];
+            if (changed != nullptr && (id == NO_TRIANGLE || !(*changed)[id])) {
+                continue;
+            }
+            uint8_t shade = id == NO_TRIANGLE ? 0 : m_shades[id];
+            uint8_t* p = data + (x + y * m_width) * 3;
+            p[0] = shade;
+            p[1] = shade;
+            p[2] = shade;
+            ++m_numShadedPixels;
+        }
+    }
+}
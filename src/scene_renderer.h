@@ -0,0 +1,81 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "clip.h"
+#include "model.h"
+#include "raster.h"
+#include "tga.h"
+#include "vec3.h"
+
+// Renders a set of flat-shaded objects and keeps the per-pixel triangle ID and
+// depth between frames, so light changes only re-shade pixels and object moves
+// only re-rasterize the screen tiles they touch.
+class SceneRenderer final
+{
+public:
+    static constexpr int32_t TILE_SIZE = 32;
+    static constexpr uint32_t NO_TRIANGLE = 0xffffffffu;
+
+    SceneRenderer(int32_t width, int32_t height, int32_t depth);
+    ~SceneRenderer();
+
+    // world = model vertex * scale + offset, in [-1, 1] screen space.
+    uint32_t AddObject(const Model* model, float scale, const Vec3f& offset);
+    void MoveObject(uint32_t object, const Vec3f& offset);
+    void SetLight(const Vec3f& lightDir);
+
+    // Full frame: rasterizes every object and shades every pixel.
+    void Render();
+    // Re-shades pixels whose triangle changed shade and re-rasterizes dirty tiles.
+    // Returns the number of tiles re-rasterized.
+    uint32_t Update();
+
+    const TGAImage& GetImage() const { return m_image; }
+    uint32_t GetNumShadedPixels() const { return m_numShadedPixels; }
+
+private:
+    struct Object final
+    {
+        const Model* model{};
+        float scale{};
+        Vec3f offset{};
+        uint32_t firstTriangle{};
+        std::vector<Vec3i> screenVerts{};
+        // Kept only while some vertex lies outside the guard band or near/far
+        // planes; faces then go through the clip stage.
+        std::vector<Vec3f> worldVerts{};
+        std::vector<uint8_t> visible{};
+        Rect bounds{};
+    };
+
+    void TransformObject(Object& obj);
+    void MarkDirty(const Rect& r);
+    // Face as a screen-space convex polygon fanned from poly[0]; returns the
+    // vertex count, 0 when it is clipped away.
+    uint32_t GetScreenPolygon(const Object& obj, uint32_t face, Vec3i poly[MAX_CLIP_VERTS]) const;
+    void RasterizeObject(const Object& obj, const Rect& clip);
+    void RasterizeDirtyTiles(const Object& obj, const Rect& dirty);
+    Rect GetTileRect(int32_t tx, int32_t ty) const;
+    void ComputeShades(std::vector<uint8_t>& shades) const;
+    void ComputeObjectShades(const Object& obj, std::vector<uint8_t>& shades) const;
+    void ShadePixels(const Rect& r, const std::vector<uint8_t>* changed);
+
+private:
+    int32_t m_width{};
+    int32_t m_height{};
+    int32_t m_depth{};
+    int32_t m_tilesX{};
+    int32_t m_tilesY{};
+    TGAImage m_image;
+    std::vector<int32_t> m_zbuffer{};
+    std::vector<uint32_t> m_triangleIds{};
+    std::vector<Object> m_objects{};
+    uint32_t m_numTriangles{};
+    Vec3f m_lightDir{};
+    std::vector<uint8_t> m_shades{};
+    std::vector<uint8_t> m_dirtyTiles{};
+    bool m_lightDirty{};
+    uint32_t m_numShadedPixels{};
+};
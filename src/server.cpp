@@ -0,0 +1,507 @@
+﻿#include "server.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+#if !defined(OS_WINDOWS)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// A client that stops reading its replies releases the worker after this long.
+static const int32_t CLIENT_SEND_TIMEOUT_S = 5;
+
+// Request paths are bare names inside a directory the server was given.
+static bool IsBareFileName(const std::string& name)
+{
+    return !name.empty() && name.find('/') == std::string::npos && name.find("..") == std::string::npos;
+}
+
+static bool ParseFloats(const std::string& value, float* out, uint32_t count)
+{
+    const char* p = value.c_str();
+    for (uint32_t i = 0; i < count; ++i) {
+        char* end = nullptr;
+        out[i] = strtof(p, &end);
+        if (end == p || (i + 1 < count && *end != ',')) {
+            return false;
+        }
+        p = end + 1;
+    }
+    return true;
+}
+
+bool ParseRenderRequest(const std::string& line, RenderRequest& req, std::string& error)
+{
+    std::istringstream iss(line);
+    std::string token;
+    while (iss >> token) {
+        size_t eq = token.find('=');
+        if (eq == std::string::npos) {
+            error = "malformed token " + token;
+            return false;
+        }
+        std::string key = token.substr(0, eq);
+        std::string value = token.substr(eq + 1);
+        float f[3];
+        if (key == "model") {
+            if (!IsBareFileName(value)) {
+                error = "model must be a file name";
+                return false;
+            }
+            req.modelName = value;
+        } else if (key == "width") {
+            req.width = atoi(value.c_str());
+        } else if (key == "height") {
+            req.height = atoi(value.c_str());
+        } else if (key == "yaw" && ParseFloats(value, f, 1)) {
+            req.yaw = f[0];
+        } else if (key == "zoom" && ParseFloats(value, f, 1)) {
+            req.zoom = f[0];
+        } else if (key == "pan" && ParseFloats(value, f, 2)) {
+            req.pan = Vec3f(f[0], f[1], 0.f);
+        } else if (key == "light" && ParseFloats(value, f, 3)) {
+            req.light = Vec3f(f[0], f[1], f[2]);
+        } else if (key == "out") {
+            if (!IsBareFileName(value)) {
+                error = "out must be a file name";
+                return false;
+            }
+            req.outPath = value;
+        } else if (key == "rle") {
+            req.rle = value != "0";
+        } else {
+            error = "bad key " + key;
+            return false;
+        }
+    }
+    if (req.modelName.empty()) {
+        error = "missing model";
+        return false;
+    }
+    if (req.width <= 0 || req.height <= 0) {
+        error = "bad size";
+        return false;
+    }
+    return true;
+}
+
+#if !defined(OS_WINDOWS)
+
+static bool WriteAll(int32_t fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Reads up to and excluding the next '\n'; bytes past it stay in buffer.
+// Fails on lines longer than MAX_REQUEST_LINE.
+static bool ReadLine(int32_t fd, std::string& buffer, std::string& line)
+{
+    for (;;) {
+        size_t nl = buffer.find('\n');
+        if (nl != std::string::npos) {
+            line.assign(buffer, 0, nl);
+            buffer.erase(0, nl + 1);
+            return true;
+        }
+        if (buffer.size() > MAX_REQUEST_LINE) {
+            return false;
+        }
+        char chunk[4096];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, n);
+    }
+}
+
+static bool ReadExactly(int32_t fd, std::string& buffer, size_t size)
+{
+    char chunk[65536];
+    while (buffer.size() < size) {
+        ssize_t n = recv(fd, chunk, std::min(sizeof(chunk), size - buffer.size()), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, n);
+    }
+    return true;
+}
+
+RenderServer::RenderServer(size_t cacheBudget)
+    : m_assets(cacheBudget)
+{}
+
+RenderServer::~RenderServer()
+{
+    if (m_listenFd >= 0) {
+        close(m_listenFd);
+        unlink(m_socketPath.c_str());
+    }
+    for (int32_t fd : m_wakeFds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool RenderServer::Start(const char* socketPath, uint32_t numThreads, int32_t maxWidth, int32_t maxHeight, const char* modelDir, const char* outputDir)
+{
+    sockaddr_un addr{};
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+        ERRORF("socket path too long %s", socketPath);
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath);
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listenFd < 0) {
+        ERRORF("can't create socket");
+        return false;
+    }
+    unlink(socketPath);
+    if (bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_listenFd, 128) != 0) {
+        ERRORF("can't listen on %s", socketPath);
+        close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+    m_socketPath = socketPath;
+    // Run only accepts after poll reports a pending connection, but one reset
+    // in between must not block it.
+    fcntl(m_listenFd, F_SETFL, fcntl(m_listenFd, F_GETFL) | O_NONBLOCK);
+    if (pipe(m_wakeFds) != 0) {
+        ERRORF("can't create the wake pipe: %s", strerror(errno));
+        return false;
+    }
+    for (int32_t fd : m_wakeFds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    m_modelDir = modelDir;
+    m_outputDir = outputDir != nullptr ? outputDir : "";
+    m_maxWidth = maxWidth;
+    m_maxHeight = maxHeight;
+    m_numThreads = numThreads > 0 ? numThreads : 1;
+    for (uint32_t i = 0; i < m_numThreads; ++i) {
+        m_workers.emplace_back(&RenderServer::WorkerMain, this);
+    }
+    INFOF("listening on %s with %u workers", socketPath, m_numThreads);
+    return true;
+}
+
+void RenderServer::Run()
+{
+    std::vector<Connection*> idle;
+    std::vector<pollfd> fds;
+    while (!m_stopping) {
+        fds.clear();
+        fds.push_back(pollfd{m_listenFd, POLLIN, 0});
+        fds.push_back(pollfd{m_wakeFds[0], POLLIN, 0});
+        for (const Connection* conn : idle) {
+            fds.push_back(pollfd{conn->fd, POLLIN, 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0 || m_stopping) {
+            continue;
+        }
+        if (fds[1].revents != 0) {
+            char drain[64];
+            while (read(m_wakeFds[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        if ((fds[0].revents & POLLIN) != 0) {
+            int32_t fd = accept(m_listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                timeval timeout{CLIENT_SEND_TIMEOUT_S, 0};
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                Connection* conn = new Connection();
+                conn->fd = fd;
+                idle.push_back(conn);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        // fds[2 + i] is idle[i]; new and returned connections are polled next time.
+        size_t numPolled = fds.size() - 2;
+        size_t kept = 0;
+        for (size_t i = 0; i < idle.size(); ++i) {
+            if (i < numPolled && fds[i + 2].revents != 0) {
+                m_ready.push_back(idle[i]);
+            } else {
+                idle[kept++] = idle[i];
+            }
+        }
+        idle.resize(kept);
+        idle.insert(idle.end(), m_returned.begin(), m_returned.end());
+        m_returned.clear();
+        if (!m_ready.empty()) {
+            m_queueCv.notify_all();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queueCv.notify_all();
+    }
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+    idle.insert(idle.end(), m_ready.begin(), m_ready.end());
+    idle.insert(idle.end(), m_returned.begin(), m_returned.end());
+    m_ready.clear();
+    m_returned.clear();
+    for (Connection* conn : idle) {
+        close(conn->fd);
+        delete conn;
+    }
+
+    AssetCache::Stats stats = m_assets.GetStats();
+    INFOF("asset cache: %llu hits, %llu misses, %llu evictions, %u entries in %.1f MiB",
+        static_cast<unsigned long long>(stats.hits), static_cast<unsigned long long>(stats.misses),
+        static_cast<unsigned long long>(stats.evictions), stats.entries, stats.bytes / (1024.0 * 1024.0));
+}
+
+void RenderServer::RequestStop()
+{
+    m_stopping = true;
+    Wake();
+}
+
+void RenderServer::Wake()
+{
+    char c = 0;
+    ssize_t n = write(m_wakeFds[1], &c, 1);
+    (void)n;
+}
+
+void RenderServer::WorkerMain()
+{
+    FrameBuffer fb(m_maxWidth, m_maxHeight);
+    for (;;) {
+        Connection* conn = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueCv.wait(lock, [this] { return m_stopping || !m_ready.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            conn = m_ready.front();
+            m_ready.pop_front();
+        }
+        if (!ServeRequest(*conn, fb)) {
+            close(conn->fd);
+            delete conn;
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        // Pipelined requests already in the buffer won't wake poll again.
+        if (conn->buffer.find('\n') != std::string::npos) {
+            m_ready.push_back(conn);
+            m_queueCv.notify_one();
+        } else {
+            m_returned.push_back(conn);
+            Wake();
+        }
+    }
+}
+
+// Takes whatever the client has sent, without waiting for more, and answers
+// the first complete request line if there is one. Returns false when the
+// connection should be closed.
+bool RenderServer::ServeRequest(Connection& conn, FrameBuffer& fb)
+{
+    size_t nl = conn.buffer.find('\n');
+    if (nl == std::string::npos && !conn.closed) {
+        char chunk[4096];
+        ssize_t n = recv(conn.fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+        if (n > 0) {
+            conn.buffer.append(chunk, n);
+            nl = conn.buffer.find('\n');
+        } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            conn.closed = true;
+        }
+    }
+    if ((nl == std::string::npos ? conn.buffer.size() : nl) > MAX_REQUEST_LINE) {
+        static const char TOO_LONG[] = "ERR request line too long\n";
+        WriteAll(conn.fd, TOO_LONG, sizeof(TOO_LONG) - 1);
+        return false;
+    }
+    if (nl == std::string::npos) {
+        return !conn.closed;
+    }
+    std::string line(conn.buffer, 0, nl);
+    conn.buffer.erase(0, nl + 1);
+    std::string reply;
+    HandleRequest(line, fb, reply);
+    if (!WriteAll(conn.fd, reply.data(), reply.size())) {
+        return false;
+    }
+    return !conn.closed || conn.buffer.find('\n') != std::string::npos;
+}
+
+bool RenderServer::HandleRequest(const std::string& line, FrameBuffer& fb, std::string& reply)
+{
+    RenderRequest req;
+    std::string error;
+    if (!ParseRenderRequest(line, req, error)) {
+        reply = "ERR " + error + "\n";
+        return false;
+    }
+    if (req.width > m_maxWidth || req.height > m_maxHeight) {
+        reply = "ERR size exceeds the preallocated frame buffer\n";
+        return false;
+    }
+    // Devices and FIFOs would hold the worker inside Model::Load.
+    std::string modelPath = m_modelDir + "/" + req.modelName;
+    struct stat st;
+    if (stat(modelPath.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        reply = "ERR no model " + req.modelName + "\n";
+        return false;
+    }
+    std::shared_ptr<const Model> model = m_assets.GetModel(modelPath);
+    if (!model) {
+        reply = "ERR can't load " + req.modelName + "\n";
+        return false;
+    }
+
+    fb.Reset(req.width, req.height);
+    RenderModel(*model, MakeView(req.yaw, req.zoom, req.pan), req.light, fb);
+    TGAImage& image = fb.GetImage();
+    image.FlipVertically();
+    if (!req.outPath.empty()) {
+        if (m_outputDir.empty()) {
+            reply = "ERR out= needs a server output directory\n";
+            return false;
+        }
+        std::string path = m_outputDir + "/" + req.outPath;
+        if (!image.Write(path.c_str(), req.rle)) {
+            reply = "ERR can't write " + req.outPath + "\n";
+            return false;
+        }
+        reply = "OK " + req.outPath + "\n";
+        return true;
+    }
+    std::ostringstream oss;
+    if (!image.Write(oss, req.rle)) {
+        reply = "ERR can't encode the image\n";
+        return false;
+    }
+    std::string tga = oss.str();
+    reply = "OK " + std::to_string(tga.size()) + "\n";
+    reply += tga;
+    return true;
+}
+
+bool RunLoadGenerator(const char* socketPath, const std::string& requestLine, uint32_t clients, uint32_t requestsPerClient)
+{
+    sockaddr_un addr{};
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+        ERRORF("socket path too long %s", socketPath);
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath);
+
+    std::vector<std::vector<uint64_t>> latencies(clients);
+    std::atomic<uint32_t> failures{0};
+    std::vector<std::thread> threads;
+    uint64_t start = GetTimeNs();
+    for (uint32_t c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c] {
+            int32_t fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+                failures += requestsPerClient;
+                if (fd >= 0) {
+                    close(fd);
+                }
+                return;
+            }
+            std::string request = requestLine + "\n";
+            std::string buffer;
+            std::string line;
+            for (uint32_t r = 0; r < requestsPerClient; ++r) {
+                uint64_t t0 = GetTimeNs();
+                if (!WriteAll(fd, request.data(), request.size()) || !ReadLine(fd, buffer, line) || line.compare(0, 3, "OK ") != 0) {
+                    ++failures;
+                    break;
+                }
+                char* end = nullptr;
+                size_t size = strtoull(line.c_str() + 3, &end, 10);
+                if (*end == '\0') {
+                    if (!ReadExactly(fd, buffer, size)) {
+                        ++failures;
+                        break;
+                    }
+                    buffer.erase(0, size);
+                }
+                latencies[c].push_back(GetTimeNs() - t0);
+            }
+            close(fd);
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    double seconds = (GetTimeNs() - start) / 1e9;
+
+    std::vector<uint64_t> all;
+    for (const std::vector<uint64_t>& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    if (all.empty()) {
+        ERRORF("no request succeeded (%u failures)", failures.load());
+        return false;
+    }
+    std::sort(all.begin(), all.end());
+    INFOF("%zu requests from %u clients in %.2f s: %.1f req/s", all.size(), clients, seconds, all.size() / seconds);
+    INFOF("latency p50 %.3f ms p99 %.3f ms max %.3f ms, %u failures", all[all.size() / 2] / 1e6, all[all.size() * 99 / 100] / 1e6, all.back() / 1e6, failures.load());
+    return failures == 0;
+}
+
+#else
+
+RenderServer::RenderServer(size_t cacheBudget)
+    : m_assets(cacheBudget)
+{}
+
+RenderServer::~RenderServer()
+{}
+
+bool RenderServer::Start(const char* socketPath, uint32_t numThreads, int32_t maxWidth, int32_t maxHeight, const char* modelDir, const char* outputDir)
+{
+    ERRORF("the render server needs Unix domain sockets");
+    return false;
+}
+
+void RenderServer::Run()
+{}
+
+void RenderServer::RequestStop()
+{}
+
+bool RunLoadGenerator(const char* socketPath, const std::string& requestLine, uint32_t clients, uint32_t requestsPerClient)
+{
+    ERRORF("the load generator needs Unix domain sockets");
+    return false;
+}
+
+#endif
@@ -0,0 +1,101 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asset_cache.h"
+#include "model.h"
+#include "renderer.h"
+#include "vec3.h"
+
+// One request per line of at most MAX_REQUEST_LINE bytes, space separated
+// key=value pairs:
+//   model=<name> [width=<px>] [height=<px>] [yaw=<deg>] [zoom=<z>] [pan=<x>,<y>]
+//   [light=<x>,<y>,<z>] [out=<name>] [rle=0|1]
+// The reply is "OK <size>\n" followed by that many bytes of TGA, "OK <name>\n"
+// when out= asked for the image to be written to a file, or "ERR <reason>\n".
+// model= takes a bare file name, read from the server's model directory, and
+// must name a regular file there. out= takes a bare file name, written to the
+// server's output directory; it is refused when the server has none.
+static const size_t MAX_REQUEST_LINE = 16 * 1024;
+
+struct RenderRequest final
+{
+    std::string modelName{};
+    int32_t width{800};
+    int32_t height{500};
+    float yaw{};
+    float zoom{1.f};
+    Vec3f pan{};
+    Vec3f light{0.f, 0.f, -1.f};
+    std::string outPath{};
+    bool rle{true};
+};
+
+bool ParseRenderRequest(const std::string& line, RenderRequest& req, std::string& error);
+
+// Serves render requests over a Unix domain socket. Run polls the idle
+// connections and queues one as soon as it has sent something; a worker
+// thread then answers at most one request on it and hands it back, so idle
+// clients hold no worker. Each worker owns a frame buffer preallocated at the
+// maximum size. Loaded models are shared between workers through an asset
+// cache bounded by cacheBudget bytes.
+class RenderServer final
+{
+public:
+    explicit RenderServer(size_t cacheBudget);
+    ~RenderServer();
+
+    // Models are read from modelDir. outputDir enables out= requests; nullptr
+    // leaves them disabled.
+    bool Start(const char* socketPath, uint32_t numThreads, int32_t maxWidth, int32_t maxHeight, const char* modelDir, const char* outputDir);
+    // Accepts and dispatches requests until RequestStop, then joins the
+    // workers and closes every connection.
+    void Run();
+    // Async-signal-safe.
+    void RequestStop();
+
+private:
+    struct Connection final
+    {
+        int32_t fd{-1};
+        // Bytes received but not yet consumed as a request line.
+        std::string buffer{};
+        bool closed{};
+    };
+
+    void WorkerMain();
+    bool ServeRequest(Connection& conn, FrameBuffer& fb);
+    bool HandleRequest(const std::string& line, FrameBuffer& fb, std::string& reply);
+    void Wake();
+
+private:
+    int32_t m_listenFd{-1};
+    // Self-pipe: written by RequestStop and by workers returning connections.
+    int32_t m_wakeFds[2]{-1, -1};
+    std::string m_socketPath{};
+    std::string m_modelDir{};
+    std::string m_outputDir{};
+    int32_t m_maxWidth{};
+    int32_t m_maxHeight{};
+    uint32_t m_numThreads{};
+    std::atomic<bool> m_stopping{false};
+    std::vector<std::thread> m_workers{};
+    std::mutex m_queueMutex{};
+    std::condition_variable m_queueCv{};
+    // Connections with input to serve, and ones workers are done with.
+    std::deque<Connection*> m_ready{};
+    std::vector<Connection*> m_returned{};
+    AssetCache m_assets;
+};
+
+// Opens clients connections, sends requestsPerClient copies of requestLine on
+// each and reports p50/p99 latency and overall requests per second.
+bool RunLoadGenerator(const char* socketPath, const std::string& requestLine, uint32_t clients, uint32_t requestsPerClient);
@@ -0,0 +1,215 @@
+﻿#pragma once
+
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__AVX__)
+#define SIMD_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Eight float lanes: one __m256 with AVX, two __m128 with SSE2, plain array
+// otherwise. Comparisons return all-ones / all-zeros lane masks for Select.
+struct Floatx8 final
+{
+    static const int32_t WIDTH = 8;
+
+    Floatx8() {}
+
+    explicit Floatx8(float a)
+    {
+#if defined(SIMD_AVX)
+        v = _mm256_set1_ps(a);
+#elif defined(SIMD_SSE)
+        lo = _mm_set1_ps(a);
+        hi = lo;
+#else
+        for (int32_t i = 0; i < WIDTH; ++i) {
+            v[i] = a;
+        }
+#endif
+    }
+
+    static Floatx8 Load(const float* p)
+    {
+        Floatx8 r;
+#if defined(SIMD_AVX)
+        r.v = _mm256_loadu_ps(p);
+#elif defined(SIMD_SSE)
+        r.lo = _mm_loadu_ps(p);
+        r.hi = _mm_loadu_ps(p + 4);
+#else
+        for (int32_t i = 0; i < WIDTH; ++i) {
+            r.v[i] = p[i];
+        }
+#endif
+        return r;
+    }
+
+    void Store(float* p) const
+    {
+#if defined(SIMD_AVX)
+        _mm256_storeu_ps(p, v);
+#elif defined(SIMD_SSE)
+        _mm_storeu_ps(p, lo);
+        _mm_storeu_ps(p + 4, hi);
+#else
+        for (int32_t i = 0; i < WIDTH; ++i) {
+            p[i] = v[i];
+        }
+#endif
+    }
+
+#if defined(SIMD_AVX)
+#define SIMD_BINARY_OP(NAME, AVX_FN, SSE_FN, EXPR) \
+    Floatx8 NAME(const Floatx8& b) const           \
+    {                                              \
+        Floatx8 r;                                 \
+        r.v = AVX_FN(v, b.v);                      \
+        return r;                                  \
+    }
+#elif defined(SIMD_SSE)
+#define SIMD_BINARY_OP(NAME, AVX_FN, SSE_FN, EXPR) \
+    Floatx8 NAME(const Floatx8& b) const           \
+    {                                              \
+        Floatx8 r;                                 \
+        r.lo = SSE_FN(lo, b.lo);                   \
+        r.hi = SSE_FN(hi, b.hi);                   \
+        return r;                                  \
+    }
+#else
+#define SIMD_BINARY_OP(NAME, AVX_FN, SSE_FN, EXPR) \
+    Floatx8 NAME(const Floatx8& b) const           \
+    {                                              \
+        Floatx8 r;                                 \
+        for (int32_t i = 0; i < WIDTH; ++i) {      \
+            float x = v[i];                        \
+            float y = b.v[i];                      \
+            r.v[i] = EXPR;                         \
+        }                                          \
+        return r;                                  \
+    }
+#endif
+
+    SIMD_BINARY_OP(operator+, _mm256_add_ps, _mm_add_ps, x + y)
+    SIMD_BINARY_OP(operator-, _mm256_sub_ps, _mm_sub_ps, x - y)
+    SIMD_BINARY_OP(operator*, _mm256_mul_ps, _mm_mul_ps, x * y)
+    SIMD_BINARY_OP(operator/, _mm256_div_ps, _mm_div_ps, x / y)
+    SIMD_BINARY_OP(Min, _mm256_min_ps, _mm_min_ps, y < x ? y : x)
+    SIMD_BINARY_OP(Max, _mm256_max_ps, _mm_max_ps, y > x ? y : x)
+    SIMD_BINARY_OP(operator&, _mm256_and_ps, _mm_and_ps, MaskBits(x, y, 0))
+    SIMD_BINARY_OP(operator|, _mm256_or_ps, _mm_or_ps, MaskBits(x, y, 1))
+#if defined(SIMD_AVX)
+    Floatx8 operator>(const Floatx8& b) const
+    {
+        Floatx8 r;
+        r.v = _mm256_cmp_ps(v, b.v, _CMP_GT_OQ);
+        return r;
+    }
+#else
+    SIMD_BINARY_OP(operator>, _mm256_cmp_ps, _mm_cmpgt_ps, x > y ? AllOnes() : 0.f)
+#endif
+#undef SIMD_BINARY_OP
+
+    Floatx8& operator+=(const Floatx8& b)
+    {
+        *this = *this + b;
+        return *this;
+    }
+
+    Floatx8& operator-=(const Floatx8& b)
+    {
+        *this = *this - b;
+        return *this;
+    }
+
+    Floatx8& operator*=(const Floatx8& b)
+    {
+        *this = *this * b;
+        return *this;
+    }
+
+    Floatx8 Sqrt() const
+    {
+        Floatx8 r;
+#if defined(SIMD_AVX)
+        r.v = _mm256_sqrt_ps(v);
+#elif defined(SIMD_SSE)
+        r.lo = _mm_sqrt_ps(lo);
+        r.hi = _mm_sqrt_ps(hi);
+#else
+        for (int32_t i = 0; i < WIDTH; ++i) {
+            r.v[i] = std::sqrt(v[i]);
+        }
+#endif
+        return r;
+    }
+
+    // a * b + c, fused where the target has FMA.
+    static Floatx8 MulAdd(const Floatx8& a, const Floatx8& b, const Floatx8& c)
+    {
+#if defined(SIMD_AVX) && defined(__FMA__)
+        Floatx8 r;
+        r.v = _mm256_fmadd_ps(a.v, b.v, c.v);
+        return r;
+#else
+        return a * b + c;
+#endif
+    }
+
+    // Lanes of a where mask is set, b elsewhere.
+    static Floatx8 Select(const Floatx8& mask, const Floatx8& a, const Floatx8& b)
+    {
+        Floatx8 r;
+#if defined(SIMD_AVX)
+        r.v = _mm256_blendv_ps(b.v, a.v, mask.v);
+#elif defined(SIMD_SSE)
+        r.lo = _mm_or_ps(_mm_and_ps(mask.lo, a.lo), _mm_andnot_ps(mask.lo, b.lo));
+        r.hi = _mm_or_ps(_mm_and_ps(mask.hi, a.hi), _mm_andnot_ps(mask.hi, b.hi));
+#else
+        for (int32_t i = 0; i < WIDTH; ++i) {
+            r.v[i] = MaskBits(mask.v[i], 0.f, 1) != 0.f ? a.v[i] : b.v[i];
+        }
+#endif
+        return r;
+    }
+
+    float operator[](int32_t i) const
+    {
+        float lanes[WIDTH];
+        Store(lanes);
+        return lanes[i];
+    }
+
+#if defined(SIMD_AVX)
+    __m256 v;
+#elif defined(SIMD_SSE)
+    __m128 lo;
+    __m128 hi;
+#else
+    float v[WIDTH];
+
+private:
+    static float AllOnes()
+    {
+        uint32_t bits = 0xffffffffu;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    static float MaskBits(float x, float y, int32_t op)
+    {
+        uint32_t a, b;
+        memcpy(&a, &x, sizeof(a));
+        memcpy(&b, &y, sizeof(b));
+        a = op == 0 ? (a & b) : (a | b);
+        memcpy(&x, &a, sizeof(x));
+        return x;
+    }
+#endif
+};
@@ -1,5 +1,9 @@
 ﻿#include "tga.h"
 
+#include <string.h>
+#include <vector>
+
+#include "kernels.h"
 #include "util.h"
 
 TGAImage::TGAImage()
@@ -12,6 +16,7 @@ TGAImage::TGAImage(uint32_t w, uint32_t h, TGAFormat format)
     m_bytesPP = static_cast<uint8_t>(format);
     uint32_t nbytes = m_width * m_height * m_bytesPP;
     m_data = new uint8_t[nbytes];
+    m_capacity = nbytes;
     memset(m_data, 0, nbytes);
 }
 
@@ -22,6 +27,7 @@ TGAImage::TGAImage(const TGAImage& img)
     m_bytesPP = img.m_bytesPP;
     uint32_t nbytes = m_width * m_height * m_bytesPP;
     m_data = new uint8_t[nbytes];
+    m_capacity = nbytes;
     memcpy(m_data, img.m_data, nbytes);
 }
 
@@ -61,6 +67,7 @@ bool TGAImage::Read(const char* fileName)
 
     uint32_t nbytes = m_width * m_height * m_bytesPP;
     m_data = new uint8_t[nbytes];
+    m_capacity = nbytes;
 
     if (header.ImageType == 2 || header.ImageType == 3) {
         if (!ifs.read(reinterpret_cast<char*>(m_data), nbytes)) {
@@ -94,15 +101,21 @@ bool TGAImage::Read(const char* fileName)
 
 bool TGAImage::Write(const char* fileName, bool rle)
 {
-    char developerAreaRef[4] = {0, 0, 0, 0};
-    char extensionAreaRef[4] = {0, 0, 0, 0};
-    char footer[] = {'T', 'R', 'U', 'E', 'V', 'I', 'S', 'I', 'O', 'N', '-', 'X', 'F', 'I', 'L', 'E', '.', '\0'};
-
     std::ofstream ofs{fileName, std::ios::binary};
     if (!ofs.is_open()) {
         ERRORF("can't open file %s", fileName);
         return false;
     }
+    bool written = Write(ofs, rle);
+    ofs.close();
+    return written;
+}
+
+bool TGAImage::Write(std::ostream& os, bool rle)
+{
+    char developerAreaRef[4] = {0, 0, 0, 0};
+    char extensionAreaRef[4] = {0, 0, 0, 0};
+    char footer[] = {'T', 'R', 'U', 'E', 'V', 'I', 'S', 'I', 'O', 'N', '-', 'X', 'F', 'I', 'L', 'E', '.', '\0'};
 
     TGAHeader header{};
     header.PixelDepth = m_bytesPP << 3;
@@ -111,45 +124,53 @@ bool TGAImage::Write(const char* fileName, bool rle)
     header.ImageType = (static_cast<TGAFormat>(m_bytesPP) == TGAFormat::GrayScale ? (rle ? 11 : 3) : (rle ? 10 : 2));
     header.ImageDescriptor = 0x20;
 
-    if (!ofs.write(reinterpret_cast<char*>(&header), sizeof(header))) {
+    if (!os.write(reinterpret_cast<char*>(&header), sizeof(header))) {
         ERRORF("can't dump the tga file");
-        ofs.close();
         return false;
     }
 
     if (!rle) {
-        if (!ofs.write(reinterpret_cast<char*>(m_data), m_width * m_height * m_bytesPP)) {
+        if (!os.write(reinterpret_cast<char*>(m_data), m_width * m_height * m_bytesPP)) {
             ERRORF("can't unload raw data");
-            ofs.close();
             return false;
         }
     } else {
-        if (!UnloadRLEData(ofs)) {
+        if (!UnloadRLEData(os)) {
             ERRORF("can't unload rle data");
-            ofs.close();
             return false;
         }
     }
 
-    if (!ofs.write(developerAreaRef, sizeof(developerAreaRef))) {
+    if (!os.write(developerAreaRef, sizeof(developerAreaRef))) {
         ERRORF("can't dump the tga file");
-        ofs.close();
         return false;
     }
 
-    if (!ofs.write(extensionAreaRef, sizeof(extensionAreaRef))) {
+    if (!os.write(extensionAreaRef, sizeof(extensionAreaRef))) {
         ERRORF("can't dump the tga file");
-        ofs.close();
         return false;
     }
 
-    if (!ofs.write(footer, sizeof(extensionAreaRef))) {
+    if (!os.write(footer, sizeof(extensionAreaRef))) {
         ERRORF("can't dump the tga file");
-        ofs.close();
         return false;
     }
 
-    ofs.close();
+    return true;
+}
+
+bool TGAImage::Reset(uint32_t w, uint32_t h, TGAFormat format)
+{
+    uint32_t nbytes = w * h * static_cast<uint8_t>(format);
+    if (nbytes > m_capacity) {
+        ClearData();
+        m_data = new uint8_t[nbytes];
+        m_capacity = nbytes;
+    }
+    m_width = w;
+    m_height = h;
+    m_bytesPP = static_cast<uint8_t>(format);
+    memset(m_data, 0, nbytes);
     return true;
 }
 
@@ -158,99 +179,42 @@ void TGAImage::ClearData()
     if (m_data != nullptr) {
         delete[] m_data;
         m_data = nullptr;
+        m_capacity = 0;
     }
 }
 
 bool TGAImage::LoadRLEData(std::ifstream& ifs)
 {
-    uint32_t pixelCount = m_width * m_height;
-    uint32_t currentPixel = 0;
-    uint32_t currentByte = 0;
-    TGAColor colorBuffer;
-
-    do {
-        uint8_t chunkHeader = ifs.get();
-        if (!ifs.good()) {
-            ERRORF("an error occured while reading the data");
-            return false;
-        }
-        if (chunkHeader < 128) {
-            chunkHeader++;
-            for (uint8_t i = 0; i < chunkHeader; ++i) {
-                if (!ifs.read(reinterpret_cast<char*>(colorBuffer.raw), m_bytesPP)) {
-                    ERRORF("an error occured while reading the header");
-                    return false;
-                }
-                for (uint8_t j = 0; j < m_bytesPP; ++j) {
-                    m_data[currentByte++] = colorBuffer.raw[j];
-                }
-                ++currentPixel;
-                if (currentPixel > pixelCount) {
-                    ERRORF("too many pixels read");
-                    return false;
-                }
-            }
-        } else {
-            chunkHeader -= 127;
-            if (!ifs.read(reinterpret_cast<char*>(colorBuffer.raw), m_bytesPP)) {
-                ERRORF("an error occured while reading the header");
-                return false;
-            }
-            for (uint8_t i = 0; i < chunkHeader; ++i) {
-                for (uint8_t j = 0; j < m_bytesPP; ++j) {
-                    m_data[currentByte++] = colorBuffer.raw[j];
-                }
-                ++currentPixel;
-                if (currentPixel > pixelCount) {
-                    ERRORF("too many pixels read");
-                    return false;
-                }
-            }
-        }
-    } while (currentPixel < pixelCount);
-
+    // The packets run to the end of the pixel data, which is at most the rest
+    // of the file; decode them from memory.
+    std::streampos start = ifs.tellg();
+    ifs.seekg(0, std::ios::end);
+    std::streamoff size = ifs.tellg() - start;
+    ifs.seekg(start);
+    if (size <= 0) {
+        ERRORF("an error occured while reading the data");
+        return false;
+    }
+    std::vector<uint8_t> packets(static_cast<size_t>(size));
+    if (!ifs.read(reinterpret_cast<char*>(packets.data()), size)) {
+        ERRORF("an error occured while reading the data");
+        return false;
+    }
+    if (!GetKernels().rleDecode(packets.data(), packets.size(), m_data, m_width * m_height, m_bytesPP)) {
+        ERRORF("truncated packets or too many pixels read");
+        return false;
+    }
     return true;
 }
 
-bool TGAImage::UnloadRLEData(std::ofstream& ofs)
+bool TGAImage::UnloadRLEData(std::ostream& ofs)
 {
-    uint8_t maxChunkLength = 128;
     uint32_t nPixels = m_width * m_height;
-    uint32_t curPix = 0;
-
-    while (curPix < nPixels) {
-        uint32_t chunkStart = curPix * m_bytesPP;
-        uint32_t curByte = curPix * m_bytesPP;
-        uint8_t runLength = 1;
-        bool raw = true;
-
-        while (curPix + runLength < nPixels && runLength < maxChunkLength) {
-            bool succEq = true;
-            for (int32_t t = 0; succEq && t < m_bytesPP; ++t) {
-                succEq = m_data[curByte + t] == m_data[curByte + t + m_bytesPP];
-            }
-            curByte += m_bytesPP;
-            if (runLength == 1) {
-                raw = !succEq;
-            }
-            if (raw && succEq) {
-                runLength--;
-                break;
-            }
-            if (!raw && !succEq) {
-                break;
-            }
-            runLength++;
-        }
-        curPix += runLength;
-        if (!ofs.put(raw ? runLength - 1 : runLength + 127)) {
-            ERRORF("can't dump the tga file");
-            return false;
-        }
-        if (!ofs.write(reinterpret_cast<char*>(m_data + chunkStart), raw ? runLength * m_bytesPP : m_bytesPP)) {
-            ERRORF("can't dump the tga file");
-            return false;
-        }
+    std::vector<uint8_t> packets(static_cast<size_t>(nPixels) * (m_bytesPP + 1));
+    size_t size = GetKernels().rleEncode(m_data, nPixels, m_bytesPP, packets.data());
+    if (!ofs.write(reinterpret_cast<char*>(packets.data()), size)) {
+        ERRORF("can't dump the tga file");
+        return false;
     }
     return true;
 }
@@ -260,17 +224,7 @@ bool TGAImage::FlipVertically()
     if (m_data == nullptr) {
         return false;
     }
-    uint32_t bytesPerLine = m_width * m_bytesPP;
-    uint8_t* pLine = new uint8_t[bytesPerLine];
-    uint32_t half = m_height >> 1;
-    for (uint32_t i = 0; i < half; ++i) {
-        uint32_t l1 = i * bytesPerLine;
-        uint32_t l2 = (m_height - i - 1) * bytesPerLine;
-        memcpy(pLine, m_data + l1, bytesPerLine);
-        memcpy(m_data + l1, m_data + l2, bytesPerLine);
-        memcpy(m_data + l2, pLine, bytesPerLine);
-    }
-    delete[] pLine;
+    GetKernels().flipVertically(m_data, m_width * m_bytesPP, m_height);
     return true;
 }
 
@@ -279,15 +233,7 @@ bool TGAImage::FlipHorizontally()
     if (m_data == nullptr) {
         return false;
     }
-    uint32_t half = m_width >> 1;
-    for (uint32_t i = 0; i < half; ++i) {
-        for (uint32_t j = 0; j < m_height; ++j) {
-            const TGAColor& c1 = GetColor(i, j);
-            const TGAColor& c2 = GetColor(m_width - i - 1, j);
-            SetColor(i, j, c2);
-            SetColor(m_width - i - 1, j, c1);
-        }
-    }
+    GetKernels().flipHorizontally(m_data, m_width, m_height, m_bytesPP);
     return true;
 }
 
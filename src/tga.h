@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include <fstream>
+#include <stdint.h>
 
 #pragma pack(push, 1)
 struct TGAHeader final
@@ -31,7 +32,7 @@ struct TGAColor final
         : b(b)
         , g(g)
         , r(r)
-        , a(a)
+        , a(A)
         , bytesPP(4)
     {}
 
@@ -95,20 +96,29 @@ public:
     bool Initialize();
     bool Read(const char* fileName);
     bool Write(const char* fileName, bool rle = true);
+    bool Write(std::ostream& os, bool rle = true);
+    // Resizes and clears; the pixel buffer is only reallocated when it grows.
+    bool Reset(uint32_t w, uint32_t h, TGAFormat format);
     bool FlipVertically();
     bool FlipHorizontally();
     TGAColor GetColor(uint32_t x, uint32_t y) const;
     bool SetColor(uint32_t x, uint32_t y, const TGAColor& c);
     uint32_t GetWidth() const { return m_width; }
     uint32_t GetHeight() const { return m_height; }
+    uint32_t GetBytesPP() const { return m_bytesPP; }
+    uint8_t* GetData() { return m_data; }
+    const uint8_t* GetData() const { return m_data; }
+    // Bytes of pixel data: width x height x bytes per pixel.
+    size_t GetMemoryUsage() const { return static_cast<size_t>(m_width) * m_height * m_bytesPP; }
 
 private:
     void ClearData();
     bool LoadRLEData(std::ifstream& ifs);
-    bool UnloadRLEData(std::ofstream& ofs);
+    bool UnloadRLEData(std::ostream& ofs);
 
 private:
     uint8_t* m_data{};
+    uint32_t m_capacity{};
     uint32_t m_width{};
     uint32_t m_height{};
     uint8_t m_bytesPP{};
@@ -1,13 +1,243 @@
 #include "util.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <thread>
 
-void Logf(FILE* fp, const char* file, int32_t line, const char* func, const char* format, ...)
+// Bounded multi-producer single-consumer queue of preformatted lines. A slot's
+// sequence equals its position when free and position + 1 once published, so
+// producers claim slots with one CAS and the consumer never takes a lock
+// while there are lines to write. It sleeps on a condition variable when the
+// ring is empty, and the producer that publishes next wakes it.
+static const uint32_t LOG_SLOTS = 1024;
+static const uint32_t LOG_LINE_SIZE = 500;
+
+static std::atomic<bool> s_infoToStderr{false};
+
+static FILE* GetLogStream(int32_t level)
+{
+    return level >= LOG_LEVEL_ERROR || s_infoToStderr.load(std::memory_order_relaxed) ? stderr : stdout;
+}
+
+struct LogSlot final
+{
+    std::atomic<uint64_t> sequence{};
+    int32_t level{};
+    uint32_t length{};
+    char text[LOG_LINE_SIZE]{};
+};
+
+class Logger final
+{
+public:
+    Logger()
+    {
+        for (uint32_t i = 0; i < LOG_SLOTS; ++i) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_thread = std::thread(&Logger::DrainMain, this);
+    }
+
+    bool IsRunning() const { return m_running.load(std::memory_order_acquire); }
+
+    // Returns false without touching ap once Stop has begun; the caller then
+    // writes the line itself.
+    bool Push(int32_t level, const char* file, int32_t line, const char* func, const char* format, va_list ap)
+    {
+        // Registering before checking m_running pairs with Stop clearing it
+        // before waiting for m_producers: either Stop waits for this line or
+        // this call sees that it is stopping.
+        m_producers.fetch_add(1, std::memory_order_seq_cst);
+        if (!m_running.load(std::memory_order_seq_cst)) {
+            m_producers.fetch_sub(1, std::memory_order_release);
+            return false;
+        }
+        uint64_t pos = m_head.load(std::memory_order_relaxed);
+        LogSlot* slot = nullptr;
+        for (;;) {
+            slot = &m_slots[pos % LOG_SLOTS];
+            int64_t diff = static_cast<int64_t>(slot->sequence.load(std::memory_order_acquire)) - static_cast<int64_t>(pos);
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // Full: wait for the drain thread rather than drop the line.
+                std::this_thread::yield();
+                pos = m_head.load(std::memory_order_relaxed);
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        slot->level = level;
+        slot->length = Format(slot->text, file, line, func, format, ap);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        // Pairs with the fence in WaitForLines: either the drain thread sees
+        // this line before sleeping or this sees it asleep.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_sleeping.store(false, std::memory_order_relaxed);
+            m_wake.notify_one();
+        }
+        m_producers.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void Flush()
+    {
+        uint64_t target = m_head.load(std::memory_order_acquire);
+        while (IsRunning() && m_drained.load(std::memory_order_acquire) < target) {
+            std::this_thread::yield();
+        }
+    }
+
+    void Stop()
+    {
+        m_running.store(false, std::memory_order_seq_cst);
+        // The drain thread keeps going until the last producer is out of Push,
+        // so one waiting on a full ring still gets its slot.
+        while (m_producers.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_exit = true;
+            m_wake.notify_one();
+        }
+        m_thread.join();
+    }
+
+    // Also used for direct writes once the drain thread has stopped.
+    static uint32_t Format(char* text, const char* file, int32_t line, const char* func, const char* format, va_list ap)
+    {
+        int32_t n = snprintf(text, LOG_LINE_SIZE, "%s: ", func);
+        if (n >= 0 && n < static_cast<int32_t>(LOG_LINE_SIZE)) {
+            int32_t m = vsnprintf(text + n, LOG_LINE_SIZE - n, format, ap);
+            n = m < 0 ? n : n + m;
+        }
+        if (n >= 0 && n < static_cast<int32_t>(LOG_LINE_SIZE)) {
+            n += snprintf(text + n, LOG_LINE_SIZE - n, " (%s:%d)\n", file, line);
+        }
+        if (n < 0) {
+            n = 0;
+        }
+        if (n >= static_cast<int32_t>(LOG_LINE_SIZE)) {
+            // Truncated; keep the line terminated.
+            n = LOG_LINE_SIZE - 1;
+            text[n - 4] = text[n - 3] = text[n - 2] = '.';
+            text[n - 1] = '\n';
+        }
+        return static_cast<uint32_t>(n);
+    }
+
+private:
+    void DrainMain()
+    {
+        for (;;) {
+            if (Drain()) {
+                continue;
+            }
+            if (!WaitForLines()) {
+                // Every producer has left Push; write what they published.
+                Drain();
+                return;
+            }
+        }
+    }
+
+    // Sleeps until a line is published; false once Stop asks the thread to exit.
+    bool WaitForLines()
+    {
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_slots[m_tail % LOG_SLOTS].sequence.load(std::memory_order_relaxed) == m_tail + 1) {
+            m_sleeping.store(false, std::memory_order_relaxed);
+            return true;
+        }
+        m_wake.wait(lock, [this] { return !m_sleeping.load(std::memory_order_relaxed) || m_exit; });
+        m_sleeping.store(false, std::memory_order_relaxed);
+        return !m_exit;
+    }
+
+    // Writes every published line in order; returns false if there was none.
+    bool Drain()
+    {
+        uint64_t start = m_tail;
+        for (;;) {
+            LogSlot& slot = m_slots[m_tail % LOG_SLOTS];
+            if (slot.sequence.load(std::memory_order_acquire) != m_tail + 1) {
+                break;
+            }
+            fwrite(slot.text, 1, slot.length, GetLogStream(slot.level));
+            slot.sequence.store(m_tail + LOG_SLOTS, std::memory_order_release);
+            ++m_tail;
+        }
+        if (m_tail == start) {
+            return false;
+        }
+        fflush(stdout);
+        fflush(stderr);
+        m_drained.store(m_tail, std::memory_order_release);
+        return true;
+    }
+
+private:
+    LogSlot m_slots[LOG_SLOTS]{};
+    std::atomic<uint64_t> m_head{0};
+    uint64_t m_tail{};
+    std::atomic<uint64_t> m_drained{0};
+    std::atomic<bool> m_running{true};
+    // Threads inside Push; Stop waits for it to drop to zero.
+    std::atomic<uint32_t> m_producers{0};
+    std::atomic<bool> m_sleeping{false};
+    std::mutex m_wakeMutex{};
+    std::condition_variable m_wake{};
+    bool m_exit{};
+    std::thread m_thread{};
+};
+
+// Never destroyed: the drain thread is stopped from atexit instead, and
+// messages logged after that are written directly.
+static Logger* GetLogger()
+{
+    static Logger* logger = [] {
+        Logger* l = new Logger();
+        atexit([] { GetLogger()->Stop(); });
+        return l;
+    }();
+    return logger;
+}
+
+uint64_t GetTimeNs()
 {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Logf(int32_t level, const char* file, int32_t line, const char* func, const char* format, ...)
+{
+    Logger* logger = GetLogger();
     va_list ap;
-    fprintf(fp, "%s: ", func);
     va_start(ap, format);
-    vfprintf(fp, format, ap);
+    if (!logger->Push(level, file, line, func, format, ap)) {
+        char text[LOG_LINE_SIZE];
+        uint32_t length = Logger::Format(text, file, line, func, format, ap);
+        fwrite(text, 1, length, GetLogStream(level));
+    }
     va_end(ap);
-    fprintf(fp, " (%s:%d)\n", file, line);
+}
+
+void FlushLog()
+{
+    GetLogger()->Flush();
+}
+
+void SetInfoLogToStderr()
+{
+    s_infoToStderr.store(true, std::memory_order_relaxed);
 }
@@ -3,7 +3,33 @@
 #include <stdint.h>
 #include <stdio.h>
 
-void Logf(FILE* fp, const char* file, int32_t line, const char* func, const char* format, ...);
+#define LOG_LEVEL_INFO 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_NONE 2
 
-#define ERRORF(...) Logf(stderr, __FILE__, __LINE__, __func__, __VA_ARGS__)
-#define INFOF(...) Logf(stdout, __FILE__, __LINE__, __func__, __VA_ARGS__)
+// Messages below this level compile to dead code that is never evaluated;
+// build with -DLOG_MIN_LEVEL=LOG_LEVEL_ERROR to drop INFOF entirely.
+#if !defined(LOG_MIN_LEVEL)
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+
+uint64_t GetTimeNs();
+// Formats into a lock-free queue drained to stdout (info) or stderr (error)
+// by a background thread, so callers never wait on the stdio lock.
+void Logf(int32_t level, const char* file, int32_t line, const char* func, const char* format, ...);
+// Blocks until every message queued so far has been written.
+void FlushLog();
+// Sends info messages to stderr too, for modes that write data to stdout.
+void SetInfoLogToStderr();
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
+#define ERRORF(...) Logf(LOG_LEVEL_ERROR, __FILE__, __LINE__, __func__, __VA_ARGS__)
+#else
+#define ERRORF(...) do { if (false) Logf(LOG_LEVEL_ERROR, __FILE__, __LINE__, __func__, __VA_ARGS__); } while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define INFOF(...) Logf(LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, __VA_ARGS__)
+#else
+#define INFOF(...) do { if (false) Logf(LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, __VA_ARGS__); } while (0)
+#endif
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include <cmath>
+#include <stdint.h>
 
 template<typename T>
 struct Vec3 final
@@ -0,0 +1,198 @@
+﻿#pragma once
+
+#include <vector>
+
+#include "mat4.h"
+#include "simd.h"
+#include "vec3.h"
+
+// Structure-of-arrays batches of eight vectors, mirroring the Vec3f / Vec4f API.
+struct Vec3x8f final
+{
+    Vec3x8f() {}
+
+    explicit Vec3x8f(const Vec3f& a)
+        : x(a.x)
+        , y(a.y)
+        , z(a.z)
+    {}
+
+    Vec3x8f(const Floatx8& nx, const Floatx8& ny, const Floatx8& nz)
+        : x(nx)
+        , y(ny)
+        , z(nz)
+    {}
+
+    static Vec3x8f Load(const float* xs, const float* ys, const float* zs)
+    {
+        return Vec3x8f(Floatx8::Load(xs), Floatx8::Load(ys), Floatx8::Load(zs));
+    }
+
+    void Store(float* xs, float* ys, float* zs) const
+    {
+        x.Store(xs);
+        y.Store(ys);
+        z.Store(zs);
+    }
+
+    Vec3f Get(int32_t i) const
+    {
+        return Vec3f(x[i], y[i], z[i]);
+    }
+
+    Vec3x8f operator+(const Vec3x8f& v) const
+    {
+        return Vec3x8f(x + v.x, y + v.y, z + v.z);
+    }
+
+    Vec3x8f operator-(const Vec3x8f& v) const
+    {
+        return Vec3x8f(x - v.x, y - v.y, z - v.z);
+    }
+
+    Vec3x8f operator*(const Floatx8& f) const
+    {
+        return Vec3x8f(x * f, y * f, z * f);
+    }
+
+    // Unfused and in the same order as Vec3::Dot, so lanes match the scalar result.
+    Floatx8 Dot(const Vec3x8f& v) const
+    {
+        return x * v.x + y * v.y + z * v.z;
+    }
+
+    Vec3x8f Cross(const Vec3x8f& v) const
+    {
+        return Vec3x8f(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x);
+    }
+
+    Floatx8 MagnitudeSquared() const
+    {
+        return Dot(*this);
+    }
+
+    Floatx8 Magnitude() const
+    {
+        return MagnitudeSquared().Sqrt();
+    }
+
+    // Like Vec3::Normalize, zero-length lanes are left untouched.
+    Floatx8 Normalize()
+    {
+        const Floatx8 m = Magnitude();
+        const Floatx8 zero(0.f);
+        const Floatx8 inv = Floatx8::Select(m > zero, Floatx8(1.f) / m, Floatx8(1.f));
+        x *= inv;
+        y *= inv;
+        z *= inv;
+        return m;
+    }
+
+    Floatx8 x;
+    Floatx8 y;
+    Floatx8 z;
+};
+
+struct Vec4x8f final
+{
+    Vec4x8f() {}
+
+    Vec4x8f(const Floatx8& nx, const Floatx8& ny, const Floatx8& nz, const Floatx8& nw)
+        : x(nx)
+        , y(ny)
+        , z(nz)
+        , w(nw)
+    {}
+
+    Vec4x8f(const Vec3x8f& v, const Floatx8& nw)
+        : x(v.x)
+        , y(v.y)
+        , z(v.z)
+        , w(nw)
+    {}
+
+    Vec3x8f Xyz() const
+    {
+        return Vec3x8f(x, y, z);
+    }
+
+    Vec3x8f PerspectiveDivide() const
+    {
+        const Floatx8 inv = Floatx8(1.f) / w;
+        return Vec3x8f(x * inv, y * inv, z * inv);
+    }
+
+    Floatx8 x;
+    Floatx8 y;
+    Floatx8 z;
+    Floatx8 w;
+};
+
+inline Vec4x8f Transform(const Mat4& a, const Vec4x8f& v)
+{
+    Vec4x8f r;
+    Floatx8* out[4] = {&r.x, &r.y, &r.z, &r.w};
+    for (int32_t i = 0; i < 4; ++i) {
+        const Floatx8 m0(a.m[i][0]);
+        const Floatx8 m1(a.m[i][1]);
+        const Floatx8 m2(a.m[i][2]);
+        const Floatx8 m3(a.m[i][3]);
+        *out[i] = Floatx8::MulAdd(m0, v.x, Floatx8::MulAdd(m1, v.y, Floatx8::MulAdd(m2, v.z, m3 * v.w)));
+    }
+    return r;
+}
+
+// Point transform with w = 1 followed by the perspective divide.
+inline Vec3x8f TransformPoint(const Mat4& a, const Vec3x8f& p)
+{
+    return Transform(a, Vec4x8f(p, Floatx8(1.f))).PerspectiveDivide();
+}
+
+inline Vec3x8f TransformDir(const Mat4& a, const Vec3x8f& d)
+{
+    return Transform(a, Vec4x8f(d, Floatx8(0.f))).Xyz();
+}
+
+// Growable SoA storage for Vec3f, padded to a whole number of batches so
+// Vec3x8f loads and stores never run past the end.
+struct Vec3SoA final
+{
+    void Resize(uint32_t n)
+    {
+        size = n;
+        uint32_t padded = (n + Floatx8::WIDTH - 1) / Floatx8::WIDTH * Floatx8::WIDTH;
+        x.assign(padded, 0.f);
+        y.assign(padded, 0.f);
+        z.assign(padded, 0.f);
+    }
+
+    uint32_t GetSize() const { return size; }
+    size_t GetMemoryUsage() const { return (x.capacity() + y.capacity() + z.capacity()) * sizeof(float); }
+
+    Vec3f Get(uint32_t i) const
+    {
+        return Vec3f(x[i], y[i], z[i]);
+    }
+
+    void Set(uint32_t i, const Vec3f& v)
+    {
+        x[i] = v.x;
+        y[i] = v.y;
+        z[i] = v.z;
+    }
+
+    Vec3x8f Load(uint32_t i) const
+    {
+        return Vec3x8f::Load(&x[i], &y[i], &z[i]);
+    }
+
+    void Store(uint32_t i, const Vec3x8f& v)
+    {
+        v.Store(&x[i], &y[i], &z[i]);
+    }
+
+    std::vector<float> x{};
+    std::vector<float> y{};
+    std::vector<float> z{};
+    uint32_t size{};
+};
@@ -0,0 +1,192 @@
+﻿#pragma once
+
+#include <cmath>
+#include <stdint.h>
+#include <type_traits>
+
+#include "vec3.h"
+
+template<typename T>
+struct Vec4 final
+{
+    Vec4()
+        : x(0)
+        , y(0)
+        , z(0)
+        , w(0)
+    {}
+
+    explicit Vec4(T a)
+        : x(a)
+        , y(a)
+        , z(a)
+        , w(a)
+    {}
+
+    Vec4(T nx, T ny, T nz, T nw)
+        : x(nx)
+        , y(ny)
+        , z(nz)
+        , w(nw)
+    {}
+
+    Vec4(const Vec3<T>& v, T nw)
+        : x(v.x)
+        , y(v.y)
+        , z(v.z)
+        , w(nw)
+    {}
+
+    Vec4(const Vec4& v)
+        : x(v.x)
+        , y(v.y)
+        , z(v.z)
+        , w(v.w)
+    {}
+
+    Vec4& operator=(const Vec4& p)
+    {
+        x = p.x;
+        y = p.y;
+        z = p.z;
+        w = p.w;
+        return *this;
+    }
+
+    bool operator==(const Vec4& v) const
+    {
+        return x == v.x && y == v.y && z == v.z && w == v.w;
+    }
+
+    bool operator!=(const Vec4& v) const
+    {
+        return x != v.x || y != v.y || z != v.z || w != v.w;
+    }
+
+    float MagnitudeSquared() const
+    {
+        return x * x + y * y + z * z + w * w;
+    }
+
+    float Magnitude() const
+    {
+        return sqrt(MagnitudeSquared());
+    }
+
+    Vec4 operator-() const
+    {
+        return Vec4(-x, -y, -z, -w);
+    }
+
+    Vec4 operator+(const Vec4& v) const
+    {
+        return Vec4(x + v.x, y + v.y, z + v.z, w + v.w);
+    }
+
+    Vec4 operator-(const Vec4& v) const
+    {
+        return Vec4(x - v.x, y - v.y, z - v.z, w - v.w);
+    }
+
+    // Float scaling only exists for float vectors, so a Vec4i can't be
+    // truncated through a float by accident; integer vectors scale by T.
+    template<typename U = T, std::enable_if_t<std::is_floating_point<U>::value, int> = 0>
+    Vec4 operator*(float f) const
+    {
+        return Vec4(x * f, y * f, z * f, w * f);
+    }
+
+    template<typename U = T, std::enable_if_t<std::is_floating_point<U>::value, int> = 0>
+    Vec4 operator/(float f) const
+    {
+        f = 1.0f / f;
+        return Vec4(x * f, y * f, z * f, w * f);
+    }
+
+    template<typename S, std::enable_if_t<std::is_integral<S>::value && std::is_integral<T>::value, int> = 0>
+    Vec4 operator*(S s) const
+    {
+        return Vec4(x * static_cast<T>(s), y * static_cast<T>(s), z * static_cast<T>(s), w * static_cast<T>(s));
+    }
+
+    Vec4& operator+=(const Vec4& v)
+    {
+        x += v.x;
+        y += v.y;
+        z += v.z;
+        w += v.w;
+        return *this;
+    }
+
+    Vec4& operator-=(const Vec4& v)
+    {
+        x -= v.x;
+        y -= v.y;
+        z -= v.z;
+        w -= v.w;
+        return *this;
+    }
+
+    template<typename U = T, std::enable_if_t<std::is_floating_point<U>::value, int> = 0>
+    Vec4& operator*=(float f)
+    {
+        x *= f;
+        y *= f;
+        z *= f;
+        w *= f;
+        return *this;
+    }
+
+    template<typename U = T, std::enable_if_t<std::is_floating_point<U>::value, int> = 0>
+    Vec4& operator/=(float f)
+    {
+        f = 1.0f / f;
+        x *= f;
+        y *= f;
+        z *= f;
+        w *= f;
+        return *this;
+    }
+
+    T Dot(const Vec4& v) const
+    {
+        return x * v.x + y * v.y + z * v.z + w * v.w;
+    }
+
+    Vec3<T> Xyz() const
+    {
+        return Vec3<T>(x, y, z);
+    }
+
+    Vec3<T> PerspectiveDivide() const
+    {
+        return Vec3<T>(x / w, y / w, z / w);
+    }
+
+    template<typename U = T, std::enable_if_t<std::is_floating_point<U>::value, int> = 0>
+    float Normalize()
+    {
+        const float m = Magnitude();
+        if (m > 0.0f)
+            *this /= m;
+        return m;
+    }
+
+    Vec4 Multiply(const Vec4& a) const
+    {
+        return Vec4(x * a.x, y * a.y, z * a.z, w * a.w);
+    }
+
+    Vec4 Abs() const
+    {
+        return Vec4(std::abs(x), std::abs(y), std::abs(z), std::abs(w));
+    }
+
+    T x;
+    T y;
+    T z;
+    T w;
+};
+
+using Vec4f = Vec4<float>;
+using Vec4i = Vec4<int32_t>;